@@ -0,0 +1,61 @@
+#include "Inputs.h"
+#include <vector>
+
+namespace inputs{
+
+  std::string sumTree(unsigned Lines, bool Declare)
+  {
+    std::string Program = "int a = 3;\n";
+    // a tree with N leaves has N - 1 inner nodes
+    unsigned Leaves = Lines > 4 ? Lines / 2 : 2;
+    std::vector<std::string> Level;
+    for (unsigned K = 0; K != Leaves; ++K)
+    {
+      std::string Name = "l" + std::to_string(K);
+      Program += (Declare ? "" : "int ") + Name + " = a + " + std::to_string(K % 10) + ";\n";
+      Level.push_back(Name);
+    }
+    unsigned Node = 0;
+    while (Level.size() > 1)
+    {
+      std::vector<std::string> Next;
+      for (size_t K = 0; K + 1 < Level.size(); K += 2)
+      {
+        std::string Name = "n" + std::to_string(Node++);
+        Program += "int " + Name + " = " + Level[K] + " + " + Level[K + 1] + ";\n";
+        Next.push_back(Name);
+      }
+      if (Level.size() % 2)
+        Next.push_back(Level.back());
+      Level.swap(Next);
+    }
+    Program += "int output = " + Level[0] + ";\n";
+    return Program;
+  }
+
+  std::string doublingChain(unsigned Length)
+  {
+    // 1 * 1 never overflows, so every link folds
+    std::string Program = "int x0 = 1;\n";
+    for (unsigned K = 1; K <= Length; ++K)
+    {
+      std::string Prev = "x" + std::to_string(K - 1);
+      Program += "int x" + std::to_string(K) + " = " + Prev + " * " + Prev + ";\n";
+    }
+    Program += "int output = x" + std::to_string(Length) + ";\n";
+    return Program;
+  }
+
+  bool generate(llvm::StringRef Shape, unsigned Size, std::string &Program)
+  {
+    if (Shape == "sumtree")
+      Program = sumTree(Size, false);
+    else if (Shape == "declare")
+      Program = sumTree(Size, true);
+    else if (Shape == "chain")
+      Program = doublingChain(Size);
+    else
+      return false;
+    return true;
+  }
+}
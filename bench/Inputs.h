@@ -0,0 +1,26 @@
+#ifndef BENCH_INPUTS_H
+#define BENCH_INPUTS_H
+
+#include "llvm/ADT/StringRef.h"
+#include <string>
+
+// Generated programs for the text Optimizer benchmarks.
+// Every program has one statement per line and ends by assigning output.
+namespace inputs{
+
+  // A balanced sum tree of about Lines statements. Every leaf reads the
+  // variable defined on the first line, every inner node adds two earlier
+  // nodes, so a reference looks up a definition far above it. With Declare
+  // the leaves are plain assignments that optimize() has to declare.
+  std::string sumTree(unsigned Lines, bool Declare);
+
+  // x1 = x0 * x0; x2 = x1 * x1; ... with Length links. Every link reads the
+  // one before it twice, so evaluating it again on every reference takes
+  // 2^Length steps.
+  std::string doublingChain(unsigned Length);
+
+  // The program of a shape by its name, false for an unknown shape
+  bool generate(llvm::StringRef Shape, unsigned Size, std::string &Program);
+}
+
+#endif
@@ -0,0 +1,112 @@
+#include "Inputs.h"
+#include "optimizer.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+// Times the text Optimizer on a generated program or a file and counts the
+// calls of operator new it makes, to check how it scales with the input.
+
+static llvm::cl::opt<std::string> Shape("shape",
+	llvm::cl::desc("Program to generate: sumtree, declare or chain"),
+	llvm::cl::init("sumtree"));
+
+static llvm::cl::opt<unsigned> Size("size",
+	llvm::cl::desc("Lines of a sumtree or declare program, links of a chain"),
+	llvm::cl::init(10000));
+
+static llvm::cl::opt<std::string> FileName("f",
+	llvm::cl::desc("Optimize this file instead of a generated program"),
+	llvm::cl::value_desc("filename"),
+	llvm::cl::init(""));
+
+static llvm::cl::opt<bool> Emit("emit",
+	llvm::cl::desc("Print the generated program instead of optimizing it"),
+	llvm::cl::init(false));
+
+static llvm::cl::opt<bool> Print("print",
+	llvm::cl::desc("Print the optimized program instead of the measurements"),
+	llvm::cl::init(false));
+
+static unsigned long long Allocations = 0;
+
+void *operator new(size_t Bytes)
+{
+  ++Allocations;
+  if (void *Memory = std::malloc(Bytes ? Bytes : 1))
+    return Memory;
+  std::abort();
+}
+
+void operator delete(void *Memory) noexcept
+{
+  std::free(Memory);
+}
+
+void operator delete(void *Memory, size_t) noexcept
+{
+  std::free(Memory);
+}
+
+int main(int argc, const char **argv)
+{
+  llvm::InitLLVM X(argc, argv);
+  llvm::cl::ParseCommandLineOptions(argc, argv, "Text Optimizer benchmark\n");
+
+  // the lexer reads up to the null character at the end of the buffer
+  std::unique_ptr<llvm::MemoryBuffer> File;
+  std::string Generated;
+  llvm::StringRef Program;
+  if (!FileName.empty())
+  {
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> FileOrErr = llvm::MemoryBuffer::getFile(FileName);
+    if (std::error_code Error = FileOrErr.getError())
+    {
+      llvm::errs() << "Error opening file: " << Error.message() << "\n";
+      return 1;
+    }
+    File = std::move(*FileOrErr);
+    Program = File->getBuffer();
+  }
+  else
+  {
+    if (!inputs::generate(Shape, Size, Generated))
+    {
+      llvm::errs() << "Unknown shape: " << Shape << "\n";
+      return 1;
+    }
+    Program = Generated;
+  }
+  if (Emit)
+  {
+    llvm::outs() << Program;
+    return 0;
+  }
+
+  unsigned long long Start = Allocations;
+  std::chrono::steady_clock::time_point Begin = std::chrono::steady_clock::now();
+  Optimizer Opt(Program);
+  std::chrono::steady_clock::time_point Lexed = std::chrono::steady_clock::now();
+  unsigned long long LexAllocations = Allocations - Start;
+  std::string Result = Opt.optimize({"output"});
+  std::chrono::steady_clock::time_point End = std::chrono::steady_clock::now();
+  unsigned long long OptimizeAllocations = Allocations - Start - LexAllocations;
+
+  if (Print)
+  {
+    llvm::outs() << Result << "\n";
+    return 0;
+  }
+
+  std::chrono::duration<double, std::milli> LexTime = Lexed - Begin, OptimizeTime = End - Lexed;
+  size_t Lines = Program.count('\n');
+  llvm::outs() << llvm::format("%-10s %10zu lines  lex %10.2f ms %12llu allocations  optimize %10.2f ms %12llu allocations  %zu bytes out\n",
+                               FileName.empty() ? Shape.c_str() : "file", Lines, LexTime.count(), LexAllocations,
+                               OptimizeTime.count(), OptimizeAllocations, Result.size());
+  return 0;
+}
@@ -0,0 +1,385 @@
+#include "ASTPrinter.h"
+#include "Evaluator.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "PassManager.h"
+#include "Sema.h"
+#include "optimizer.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/raw_ostream.h"
+#include <random>
+#include <string>
+#include <vector>
+
+// Differential test of the text Optimizer, or with -ast of the AST passes.
+// Random straight-line programs are optimized, and the original and the
+// optimized program are both run with the Evaluator. They have to print the
+// same values. Programs whose original run is undefined are skipped.
+// With -ast the programs have if/else, while and for, and every registered
+// pass on its own and the default pipeline optimize a fresh tree of each.
+
+static llvm::cl::opt<unsigned> Runs("runs",
+	llvm::cl::desc("Random programs to check"),
+	llvm::cl::init(1000));
+
+static llvm::cl::opt<unsigned> Seed("seed",
+	llvm::cl::desc("Seed of the first program, run K uses Seed + K"),
+	llvm::cl::init(1));
+
+static llvm::cl::opt<unsigned> Statements("statements",
+	llvm::cl::desc("Statements of a program"),
+	llvm::cl::init(30));
+
+static llvm::cl::opt<bool> AST("ast",
+	llvm::cl::desc("Check the AST passes on programs with control flow instead of the text Optimizer"),
+	llvm::cl::init(false));
+
+namespace fuzz{
+
+  class ProgramGenerator
+  {
+    std::mt19937 Random;
+    std::vector<std::string> Vars;
+
+    unsigned below(unsigned N)
+    {
+      return std::uniform_int_distribution<unsigned>(0, N - 1)(Random);
+    }
+
+    std::string operand()
+    {
+      if (Vars.empty() || below(3) == 0)
+        return std::to_string(below(19) + 1);   // Sema rejects a division by the literal 0
+      return Vars[below(Vars.size())];
+    }
+
+    std::string expression(unsigned Depth)
+    {
+      if (Depth == 0 || below(3) == 0)
+        return operand();
+      static const char *const Ops[] = {" + ", " - ", " * ", " / "};
+      std::string E = expression(Depth - 1) + Ops[below(4)] + expression(Depth - 1);
+      return below(4) == 0 ? "(" + E + ")" : E;
+    }
+
+  public:
+    ProgramGenerator(unsigned Seed) : Random(Seed) {}
+
+    std::string generate(unsigned Count)
+    {
+      Vars.clear();
+      std::string Program = "int output = 0;\n";
+      for (unsigned K = 0; K != Count; ++K)
+      {
+        switch (Vars.empty() ? 0 : below(5))
+        {
+        case 0:
+        {
+          std::string Name = "v" + std::to_string(Vars.size());
+          Program += "int " + Name + " = " + expression(2) + ";\n";
+          Vars.push_back(Name);
+          break;
+        }
+        case 1:
+          Program += Vars[below(Vars.size())] + " = " + expression(2) + ";\n";
+          break;
+        case 2:
+        {
+          static const char *const Ops[] = {" += ", " -= ", " *= "};
+          Program += Vars[below(Vars.size())] + Ops[below(3)] + operand() + ";\n";
+          break;
+        }
+        case 3:
+          Program += "print(" + Vars[below(Vars.size())] + ");\n";
+          break;
+        default:
+          Program += "output = " + expression(2) + ";\n";
+          break;
+        }
+      }
+      return Program + "print(output);\n";
+    }
+  };
+
+  // Programs with if/else, while and for over int and bool variables that are
+  // all declared up front. Loop counters are only changed by their own loop
+  // and the bounds are small, so every loop ends.
+  class StructuredGenerator
+  {
+    std::mt19937 Random;
+
+    unsigned below(unsigned N)
+    {
+      return std::uniform_int_distribution<unsigned>(0, N - 1)(Random);
+    }
+
+    std::string literal()
+    {
+      return std::to_string(below(21));
+    }
+
+    std::string variable(llvm::ArrayRef<std::string> Readable)
+    {
+      return Readable[below(Readable.size())];
+    }
+
+    std::string operand(llvm::ArrayRef<std::string> Readable)
+    {
+      switch (below(8))
+      {
+      case 0: case 1: case 2: return literal();
+      case 3: return "-" + literal();
+      case 4: return "-(" + variable(Readable) + " + " + literal() + ")";
+      default: return variable(Readable);
+      }
+    }
+
+    // The right operand of / and % is never 0
+    std::string expression(unsigned Depth, llvm::ArrayRef<std::string> Readable)
+    {
+      if (Depth == 0 || below(3) == 0)
+        return operand(Readable);
+      std::string Left = expression(Depth - 1, Readable);
+      switch (below(9))
+      {
+      case 0: case 1: return "(" + Left + " + " + expression(Depth - 1, Readable) + ")";
+      case 2: case 3: return "(" + Left + " - " + expression(Depth - 1, Readable) + ")";
+      case 4: case 5: return "(" + Left + " * " + expression(Depth - 1, Readable) + ")";
+      case 6: return "(" + Left + " / " + std::to_string(below(19) + 1) + ")";
+      case 7: return "(" + Left + " % (" + variable(Readable) + " % 7 + 8))";
+      default: return "((" + variable(Readable) + " % 5) ^ " + std::to_string(below(4)) + ")";
+      }
+    }
+
+    std::string condition(unsigned Depth, llvm::ArrayRef<std::string> Readable)
+    {
+      static const char *const Cmp[] = {" < ", " > ", " <= ", " >= ", " == ", " != "};
+      unsigned Kind = below(10);
+      if (Kind < 2)
+        return below(2) ? "p" : "q";
+      if (Kind == 2)
+        return below(2) ? "true" : "false";
+      if (Kind < 5 && Depth)
+        return condition(Depth - 1, Readable) + (below(2) ? " and " : " or ") + condition(Depth - 1, Readable);
+      return variable(Readable) + Cmp[below(6)] + expression(1, Readable);
+    }
+
+    std::string block(unsigned Depth, std::vector<std::string> &Readable)
+    {
+      std::string Text;
+      for (unsigned K = below(4) + 1; K != 0; --K)
+        Text += statement(Depth, Readable);
+      return Text;
+    }
+
+    std::string statement(unsigned Depth, std::vector<std::string> &Readable)
+    {
+      static const char *const Ints[] = {"a", "b", "c", "d", "e"};
+      std::string Var = Ints[below(5)];
+      switch (Depth ? below(12) : below(8) + 4)
+      {
+      case 0: case 1:
+      {
+        std::string Text = "if (" + condition(1, Readable) + ") {\n" + block(Depth - 1, Readable) + "}";
+        while (below(5) < 2)
+          Text += " else if (" + (below(2) ? Var + " == " + literal() : condition(1, Readable)) + ") {\n" +
+                  block(Depth - 1, Readable) + "}";
+        if (below(2))
+          Text += " else {\n" + block(Depth - 1, Readable) + "}";
+        return Text + "\n";
+      }
+      case 2:
+      {
+        // counters i, j and k by depth, so nested loops never share one
+        std::string Counter(1, "kji"[(Depth - 1) % 3]);
+        static const char *const Steps[] = {"++", " += 1", " += 2"};
+        std::string Bound = below(2) ? literal() : Var + " % 10";
+        std::string Header = "for (" + Counter + " = " + std::to_string(below(3)) + "; " + Counter + " < " + Bound +
+                             "; " + Counter + Steps[below(3)] + ") {\n";
+        // sometimes twice in a row, for the fusion of loops over the same range
+        std::string Text;
+        Readable.push_back(Counter);
+        for (unsigned Loops = below(4) ? 1 : 2; Loops != 0; --Loops)
+          Text += Header + block(Depth - 1, Readable) + "}\n";
+        Readable.pop_back();
+        return Text;
+      }
+      case 3:
+      {
+        std::string Counter = "w" + std::to_string(Depth);
+        Readable.push_back(Counter);
+        std::string Body = block(Depth - 1, Readable);
+        Readable.pop_back();
+        return Counter + " = " + std::to_string(below(9)) + ";\nwhile (" + Counter + " > 0) {\n" + Body + Counter +
+               " -= 1;\n}\n";
+      }
+      case 4:
+        return (below(2) ? "p" : "q") + std::string(" = ") + condition(1, Readable) + ";\n";
+      case 5:
+        return "print(" + (below(4) ? variable(Readable) : below(2) ? "p" : "q") + ");\n";
+      case 6:
+      {
+        static const char *const Ops[] = {" += ", " -= ", " *= ", " /= "};
+        unsigned Op = below(4);
+        if (Op == 3)
+          return Var + " /= " + std::to_string(below(19) + 1) + ";\n";
+        // sums are left as they are, so counting loops have closed forms
+        std::string Text = Var + Ops[Op] + operand(Readable) + ";\n";
+        return Op == 2 ? Text + Var + " = " + Var + " % 1000;\n" : Text;
+      }
+      case 7:
+        return Var + (below(2) ? "++" : "--") + ";\n";
+      case 8:
+        return Var + " = " + variable(Readable) + ";\n";
+      default:
+        return Var + " = " + expression(2, Readable) + ";\n" + Var + " = " + Var + " % 1000;\n";
+      }
+    }
+
+  public:
+    StructuredGenerator(unsigned Seed) : Random(Seed) {}
+
+    std::string generate(unsigned Count)
+    {
+      std::vector<std::string> Readable = {"a", "b", "c", "d", "e"};
+      std::string Program;
+      for (const std::string &Var : Readable)
+        Program += "int " + Var + " = " + literal() + ";\n";
+      Program += "int i = 0;\nint j = 0;\nint k = 0;\nint w1 = 0;\nint w2 = 0;\nint w3 = 0;\nint output = 0;\n";
+      Program += std::string("bool p = ") + (below(2) ? "true" : "false") + ";\nbool q = " +
+                 (below(2) ? "true" : "false") + ";\n";
+      for (unsigned K = 0; K != Count; ++K)
+        Program += statement(3, Readable);
+      Program += "output = " + expression(2, Readable) + ";\n";
+      for (const char *Var : {"a", "b", "c", "d", "e"})
+        Program += std::string("print(") + Var + ");\n";
+      return Program + "print(output);\n";
+    }
+  };
+
+  // Parses and checks a program. Returns nullptr with Error set if it can
+  // not be compiled.
+  Program *parse(const std::string &Text, std::string &Error)
+  {
+    Lexer Lex(Text);
+    Parser Parse(Lex);
+    Program *Tree = Parse.parse();
+    if (!Tree || Parse.hasError())
+    {
+      Error = "syntax error";
+      return nullptr;
+    }
+    Sema Semantic;
+    if (Semantic.semantic(Tree))
+    {
+      Error = "semantic error";
+      return nullptr;
+    }
+    return Tree;
+  }
+
+  Evaluator::Outcome evaluate(Program *Tree, llvm::SmallVectorImpl<PrintedValue> &Prints)
+  {
+    Evaluator Eval(1000000, 1 << 20);
+    return Eval.run(Tree, Prints);
+  }
+
+  bool same(llvm::ArrayRef<PrintedValue> A, llvm::ArrayRef<PrintedValue> B)
+  {
+    if (A.size() != B.size())
+      return false;
+    for (size_t K = 0; K != A.size(); ++K)
+      if (A[K].Value != B[K].Value || A[K].IsBool != B[K].IsBool)
+        return false;
+    return true;
+  }
+}
+
+int main(int argc, const char **argv)
+{
+  llvm::InitLLVM X(argc, argv);
+  llvm::cl::ParseCommandLineOptions(argc, argv, "Optimizer differential fuzzer\n");
+
+  // every registered pass on its own, then the default pipeline
+  std::vector<std::vector<std::string>> Pipelines;
+  if (AST)
+  {
+    llvm::SmallVector<llvm::StringRef> Names;
+    PassManager::passNames(Names);
+    for (llvm::StringRef Name : Names)
+      Pipelines.push_back({Name.str()});
+    llvm::ArrayRef<const char *> Default = PassManager::defaultPipeline();
+    Pipelines.emplace_back(Default.begin(), Default.end());
+  }
+
+  unsigned Checked = 0, Skipped = 0;
+  for (unsigned K = 0; K != Runs; ++K)
+  {
+    std::string Text = AST ? fuzz::StructuredGenerator(Seed + K).generate(Statements)
+                           : fuzz::ProgramGenerator(Seed + K).generate(Statements);
+    llvm::SmallVector<PrintedValue> ExpectedPrints, ActualPrints;
+    std::string Error;
+    Program *Tree = fuzz::parse(Text, Error);
+    if (!Tree)
+    {
+      llvm::errs() << "seed " << Seed + K << ": the generated program has a " << Error << "\n" << Text;
+      return 1;
+    }
+    if (fuzz::evaluate(Tree, ExpectedPrints) != Evaluator::Finished)
+    {
+      ++Skipped;
+      continue;
+    }
+    if (!AST)
+    {
+      Optimizer Opt(Text);
+      std::string Optimized = Opt.optimize({"output"});
+      Evaluator::Outcome Actual = Evaluator::Finished;
+      ActualPrints.clear();
+      Tree = fuzz::parse(Optimized, Error);
+      if (!Tree || (Actual = fuzz::evaluate(Tree, ActualPrints)) != Evaluator::Finished ||
+          !fuzz::same(ExpectedPrints, ActualPrints))
+      {
+        if (Error.empty())
+          Error = Actual != Evaluator::Finished ? "run that does not finish" : "different output";
+        llvm::errs() << "seed " << Seed + K << ": the optimized program has a " << Error << "\n"
+                     << "--- original\n" << Text << "--- optimized\n" << Optimized << "\n";
+        return 1;
+      }
+      ++Checked;
+      continue;
+    }
+    for (const std::vector<std::string> &Pipeline : Pipelines)
+    {
+      Tree = fuzz::parse(Text, Error);
+      PassManager Optimizations({"output"});
+      for (const std::string &Name : Pipeline)
+        if (!Optimizations.addPass(Name, Error))
+        {
+          llvm::errs() << Error << "\n";
+          return 1;
+        }
+      Optimizations.run(Tree, false);
+      ActualPrints.clear();
+      Evaluator::Outcome Actual = fuzz::evaluate(Tree, ActualPrints);
+      if (Actual != Evaluator::Finished || !fuzz::same(ExpectedPrints, ActualPrints))
+      {
+        llvm::errs() << "seed " << Seed + K << ": after";
+        for (const std::string &Name : Pipeline)
+          llvm::errs() << " " << Name;
+        llvm::errs() << " the program has a "
+                     << (Actual != Evaluator::Finished ? "run that does not finish" : "different output") << "\n"
+                     << "--- original\n" << Text << "--- optimized\n";
+        ASTPrinter().print(Tree, llvm::errs());
+        return 1;
+      }
+    }
+    ++Checked;
+  }
+  llvm::outs() << Checked << " programs checked";
+  if (AST)
+    llvm::outs() << " with " << Pipelines.size() << " pipelines";
+  llvm::outs() << ", " << Skipped << " skipped because their original run does not finish\n";
+  return 0;
+}
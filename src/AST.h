@@ -86,6 +86,8 @@ public:
 
   llvm::SmallVector<AST *> getdata() { return data; }
 
+  void setdata(llvm::SmallVector<AST *> D) { data = D; }
+
   dataVector::const_iterator begin() { return data.begin(); }
 
   dataVector::const_iterator end() { return data.end(); }
@@ -116,6 +118,10 @@ public:
 
   ValueVector::const_iterator valEnd() { return Values.end(); }
 
+  void setVars(llvm::SmallVector<llvm::StringRef> V) { Vars = V; }
+
+  void setValues(llvm::SmallVector<Expr *> V) { Values = V; }
+
   virtual void accept(ASTVisitor &V) override
   {
     V.visit(*this);
@@ -142,6 +148,10 @@ public:
 
   ValueVector::const_iterator valEnd() { return Values.end(); }
 
+  void setVars(llvm::SmallVector<llvm::StringRef> V) { Vars = V; }
+
+  void setValues(llvm::SmallVector<Logic *> V) { Values = V; }
+
   virtual void accept(ASTVisitor &V) override
   {
     V.visit(*this);
@@ -194,9 +204,10 @@ private:
   Expr *Left;                               // Left-hand side expression
   Expr *Right;                              // Right-hand side expression
   Operator Op;                              // Operator of the binary operation
+  bool Wraps;                               // + - * wrap around instead of overflowing
 
 public:
-  BinaryOp(Operator Op, Expr *L, Expr *R) : Op(Op), Left(L), Right(R) {}
+  BinaryOp(Operator Op, Expr *L, Expr *R, bool Wraps = false) : Op(Op), Left(L), Right(R), Wraps(Wraps) {}
 
   Expr *getLeft() { return Left; }
 
@@ -204,6 +215,12 @@ public:
 
   Operator getOperator() { return Op; }
 
+  bool wraps() { return Wraps; }
+
+  void setLeft(Expr *L) { Left = L; }
+
+  void setRight(Expr *R) { Right = R; }
+
   virtual void accept(ASTVisitor &V) override
   {
     V.visit(*this);
@@ -274,6 +291,8 @@ public:
 
   Expr *getExpr() { return expr; }
 
+  void setExpr(Expr *E) { expr = E; }
+
   virtual void accept(ASTVisitor &V) override
   {
     V.visit(*this);
@@ -309,6 +328,12 @@ public:
 
   AssignKind getAssignKind() { return AK; }
 
+  void setRightExpr(Expr *RE) { RightExpr = RE; }
+
+  void setRightLogic(Logic *RL) { RightLogicExpr = RL; }
+
+  void setAssignKind(AssignKind K) { AK = K; }
+
   virtual void accept(ASTVisitor &V) override
   {
     V.visit(*this);
@@ -346,6 +371,10 @@ public:
 
   Operator getOperator() { return Op; }
 
+  void setLeft(Expr *L) { Left = L; }
+
+  void setRight(Expr *R) { Right = R; }
+
   virtual void accept(ASTVisitor &V) override
   {
     V.visit(*this);
@@ -376,6 +405,10 @@ public:
 
   Operator getOperator() { return Op; }
 
+  void setLeft(Logic *L) { Left = L; }
+
+  void setRight(Logic *R) { Right = R; }
+
   virtual void accept(ASTVisitor &V) override
   {
     V.visit(*this);
@@ -399,6 +432,10 @@ public:
 
   Stmts::const_iterator end() { return S.end(); }
 
+  void setCond(Logic *C) { Cond = C; }
+
+  void setBody(llvm::SmallVector<AST *> Body) { S = Body; }
+
   virtual void accept(ASTVisitor &V) override
   {
     V.visit(*this);
@@ -434,6 +471,14 @@ public:
 
   elifVector::const_iterator endElif() { return elifStmts.end(); }
 
+  void setCond(Logic *C) { Cond = C; }
+
+  void setBody(llvm::SmallVector<AST *> Body) { ifStmts = Body; }
+
+  void setElse(llvm::SmallVector<AST *> Body) { elseStmts = Body; }
+
+  void setElifs(llvm::SmallVector<elifStmt *> Elifs) { elifStmts = Elifs; }
+
   virtual void accept(ASTVisitor &V) override
   {
     V.visit(*this);
@@ -457,6 +502,10 @@ public:
 
   BodyVector::const_iterator end() { return Body.end(); }
 
+  void setCond(Logic *C) { Cond = C; }
+
+  void setBody(llvm::SmallVector<AST *> B) { Body = B; }
+
   virtual void accept(ASTVisitor &V) override
   {
     V.visit(*this);
@@ -491,6 +540,10 @@ public:
 
   BodyVector::const_iterator end() { return Body.end(); }
 
+  void setSecond(Logic *S) { Second = S; }
+
+  void setBody(llvm::SmallVector<AST *> B) { Body = B; }
+
   virtual void accept(ASTVisitor &V) override
   {
     V.visit(*this);
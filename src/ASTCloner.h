@@ -0,0 +1,131 @@
+#ifndef ASTCLONER_H
+#define ASTCLONER_H
+
+#include "AST.h"
+
+// Deep copies of statements, conditions and expressions.
+// The passes rewrite nodes in place, so a statement that is duplicated,
+// such as the body of an unrolled loop, must not share any node with
+// the original.
+class ASTCloner : public ASTVisitor
+{
+  AST *Result;
+
+public:
+  AST *clone(AST *Node)
+  {
+    if (!Node)
+      return nullptr;
+    Node->accept(*this);
+    return Result;
+  }
+
+  Expr *clone(Expr *E)
+  {
+    return (Expr *)clone((AST *)E);
+  }
+
+  Logic *clone(Logic *L)
+  {
+    return (Logic *)clone((AST *)L);
+  }
+
+  template <typename Iterator>
+  llvm::SmallVector<AST *> clone(Iterator Begin, Iterator End)
+  {
+    llvm::SmallVector<AST *> Copies;
+    for (Iterator I = Begin; I != End; ++I)
+      Copies.push_back(clone((AST *)*I));
+    return Copies;
+  }
+
+  virtual void visit(Final &Node) override
+  {
+    Result = new Final(Node.getKind(), Node.getVal());
+  };
+
+  virtual void visit(BinaryOp &Node) override
+  {
+    Result = new BinaryOp(Node.getOperator(), clone(Node.getLeft()), clone(Node.getRight()), Node.wraps());
+  };
+
+  virtual void visit(UnaryOp &Node) override
+  {
+    Result = new UnaryOp(Node.getOperator(), Node.getIdent());
+  };
+
+  virtual void visit(SignedNumber &Node) override
+  {
+    Result = new SignedNumber(Node.getSign(), Node.getValue());
+  };
+
+  virtual void visit(NegExpr &Node) override
+  {
+    Result = new NegExpr(clone(Node.getExpr()));
+  };
+
+  virtual void visit(Assignment &Node) override
+  {
+    Result = new Assignment((Final *)clone((AST *)Node.getLeft()), clone(Node.getRightExpr()), Node.getAssignKind(),
+                            clone(Node.getRightLogic()));
+  };
+
+  virtual void visit(DeclarationInt &Node) override
+  {
+    llvm::SmallVector<Expr *> Values;
+    for (llvm::SmallVector<Expr *>::const_iterator I = Node.valBegin(), E = Node.valEnd(); I != E; ++I)
+      Values.push_back(clone(*I));
+    Result = new DeclarationInt(llvm::SmallVector<llvm::StringRef>(Node.varBegin(), Node.varEnd()), Values);
+  };
+
+  virtual void visit(DeclarationBool &Node) override
+  {
+    llvm::SmallVector<Logic *> Values;
+    for (llvm::SmallVector<Logic *>::const_iterator I = Node.valBegin(), E = Node.valEnd(); I != E; ++I)
+      Values.push_back(clone(*I));
+    Result = new DeclarationBool(llvm::SmallVector<llvm::StringRef>(Node.varBegin(), Node.varEnd()), Values);
+  };
+
+  virtual void visit(Comparison &Node) override
+  {
+    Result = new Comparison(clone(Node.getLeft()), clone(Node.getRight()), Node.getOperator());
+  };
+
+  virtual void visit(LogicalExpr &Node) override
+  {
+    Result = new LogicalExpr(clone(Node.getLeft()), clone(Node.getRight()), Node.getOperator());
+  };
+
+  virtual void visit(IfStmt &Node) override
+  {
+    llvm::SmallVector<elifStmt *> Elifs;
+    for (llvm::SmallVector<elifStmt *>::const_iterator I = Node.beginElif(), E = Node.endElif(); I != E; ++I)
+      Elifs.push_back((elifStmt *)clone((AST *)*I));
+    Result = new IfStmt(clone(Node.getCond()), clone(Node.begin(), Node.end()), clone(Node.beginElse(), Node.endElse()),
+                        Elifs);
+  };
+
+  virtual void visit(elifStmt &Node) override
+  {
+    Result = new elifStmt(clone(Node.getCond()), clone(Node.begin(), Node.end()));
+  };
+
+  virtual void visit(WhileStmt &Node) override
+  {
+    Result = new WhileStmt(clone(Node.getCond()), clone(Node.begin(), Node.end()));
+  };
+
+  virtual void visit(ForStmt &Node) override
+  {
+    Result = new ForStmt((Assignment *)clone((AST *)Node.getFirst()), clone(Node.getSecond()),
+                         (Assignment *)clone((AST *)Node.getThirdAssign()), (UnaryOp *)clone((AST *)Node.getThirdUnary()),
+                         clone(Node.begin(), Node.end()));
+  };
+
+  virtual void visit(PrintStmt &Node) override
+  {
+    Result = new PrintStmt(Node.getVar());
+  };
+};
+
+#endif
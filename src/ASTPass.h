@@ -0,0 +1,35 @@
+#ifndef ASTPASS_H
+#define ASTPASS_H
+
+#include "AST.h"
+#include "llvm/Support/raw_ostream.h"
+
+// Base of the optimization passes the PassManager runs.
+// A pass is started with Tree->accept(Pass) and does its work in
+// visit(Program &); the other nodes are left to the visitors it uses.
+class ASTPass : public ASTVisitor
+{
+public:
+  virtual ~ASTPass() {}
+
+  // Prints what the pass did below its line of the pass report
+  virtual void report(llvm::raw_ostream &OS) {}
+
+  virtual void visit(Final &) override {};
+  virtual void visit(BinaryOp &) override {};
+  virtual void visit(UnaryOp &) override {};
+  virtual void visit(SignedNumber &) override {};
+  virtual void visit(NegExpr &) override {};
+  virtual void visit(Assignment &) override {};
+  virtual void visit(DeclarationInt &) override {};
+  virtual void visit(DeclarationBool &) override {};
+  virtual void visit(Comparison &) override {};
+  virtual void visit(LogicalExpr &) override {};
+  virtual void visit(IfStmt &) override {};
+  virtual void visit(WhileStmt &) override {};
+  virtual void visit(elifStmt &) override {};
+  virtual void visit(ForStmt &) override {};
+  virtual void visit(PrintStmt &) override {};
+};
+
+#endif
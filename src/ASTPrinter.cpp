@@ -0,0 +1,405 @@
+#include "ASTPrinter.h"
+#include "ASTShape.h"
+#include <string>
+
+namespace printer{
+
+  // How tightly the outermost operator of a node binds, to decide on parentheses
+  class Precedence : public ASTVisitor
+  {
+  public:
+    enum
+    {
+      Logical,                      // and, or
+      Compare,                      // ==, <, ...
+      Additive,                     // +, -
+      Multiplicative,               // *, /, %
+      Power,                        // ^
+      Atom                          // numbers, names, -(...), x++
+    };
+    int Level = Atom;
+
+    virtual void visit(Final &Node) override {};
+
+    virtual void visit(BinaryOp &Node) override
+    {
+      switch (Node.getOperator())
+      {
+      case BinaryOp::Plus:
+      case BinaryOp::Minus:
+        Level = Additive;
+        break;
+      case BinaryOp::Exp:
+        Level = Power;
+        break;
+      default:
+        Level = Multiplicative;
+        break;
+      }
+    };
+
+    virtual void visit(UnaryOp &Node) override {};
+    virtual void visit(SignedNumber &Node) override {};
+    virtual void visit(NegExpr &Node) override {};
+
+    virtual void visit(Comparison &Node) override
+    {
+      if (Node.getRight())
+        Level = Compare;
+    };
+
+    virtual void visit(LogicalExpr &Node) override
+    {
+      Level = Logical;
+    };
+
+    virtual void visit(Assignment &Node) override {};
+    virtual void visit(DeclarationInt &Node) override {};
+    virtual void visit(DeclarationBool &Node) override {};
+    virtual void visit(IfStmt &Node) override {};
+    virtual void visit(WhileStmt &Node) override {};
+    virtual void visit(elifStmt &Node) override {};
+    virtual void visit(ForStmt &Node) override {};
+    virtual void visit(PrintStmt &Node) override {};
+  };
+
+  // The first variable a condition or an expression reads, empty if it reads none
+  class FirstVariable : public ASTVisitor
+  {
+  public:
+    llvm::StringRef Name;
+
+    void find(AST *Node)
+    {
+      if (Node && Name.empty())
+        Node->accept(*this);
+    }
+
+    virtual void visit(Final &Node) override
+    {
+      if (Node.getKind() == Final::Ident)
+        Name = Node.getVal();
+    };
+
+    virtual void visit(BinaryOp &Node) override
+    {
+      find(Node.getLeft());
+      find(Node.getRight());
+    };
+
+    virtual void visit(UnaryOp &Node) override
+    {
+      Name = Node.getIdent();
+    };
+
+    virtual void visit(NegExpr &Node) override
+    {
+      find(Node.getExpr());
+    };
+
+    virtual void visit(Comparison &Node) override
+    {
+      find(Node.getLeft());
+      find(Node.getRight());
+    };
+
+    virtual void visit(LogicalExpr &Node) override
+    {
+      find(Node.getLeft());
+      find(Node.getRight());
+    };
+
+    virtual void visit(SignedNumber &Node) override {};
+    virtual void visit(Assignment &Node) override {};
+    virtual void visit(DeclarationInt &Node) override {};
+    virtual void visit(DeclarationBool &Node) override {};
+    virtual void visit(IfStmt &Node) override {};
+    virtual void visit(WhileStmt &Node) override {};
+    virtual void visit(elifStmt &Node) override {};
+    virtual void visit(ForStmt &Node) override {};
+    virtual void visit(PrintStmt &Node) override {};
+  };
+
+  class PrintVisitor : public ASTVisitor
+  {
+    llvm::raw_ostream *OS;
+    unsigned Indent = 0;
+    bool Block;                     // the last printed statement ended with a body
+
+    static int level(AST *Node)
+    {
+      Precedence P;
+      Node->accept(P);
+      return P.Level;
+    }
+
+    // Prints a node into a string instead of the output
+    std::string render(AST *Node)
+    {
+      std::string Text;
+      llvm::raw_string_ostream Stream(Text);
+      llvm::raw_ostream *Saved = OS;
+      OS = &Stream;
+      Node->accept(*this);
+      OS = Saved;
+      return Stream.str();
+    }
+
+    void operand(Expr *E, bool Paren)
+    {
+      if (Paren)
+        *OS << "(";
+      E->accept(*this);
+      if (Paren)
+        *OS << ")";
+    }
+
+    void statement(AST *Node)
+    {
+      Block = false;
+      OS->indent(Indent * 2);
+      Node->accept(*this);
+      if (!Block)
+        *OS << ";";
+      *OS << "\n";
+    }
+
+    // The parser takes no empty body, so one the optimizations emptied gets
+    // Filler = Filler; instead. Filler is a variable declared in front of the
+    // statement, nothing is filled in if there is none.
+    void body(llvm::SmallVector<AST *>::const_iterator Begin, llvm::SmallVector<AST *>::const_iterator End,
+              llvm::StringRef Filler)
+    {
+      *OS << "{\n";
+      ++Indent;
+      for (llvm::SmallVector<AST *>::const_iterator I = Begin; I != End; ++I)
+        statement(*I);
+      if (Begin == End && !Filler.empty())
+      {
+        OS->indent(Indent * 2);
+        *OS << Filler << " = " << Filler << ";\n";
+      }
+      --Indent;
+      OS->indent(Indent * 2);
+      *OS << "}";
+      Block = true;
+    }
+
+    // The assignment without its semicolon, as for loop headers need it
+    void assignment(Assignment &Node)
+    {
+      *OS << Node.getLeft()->getVal();
+      switch (Node.getAssignKind())
+      {
+      case Assignment::Assign: *OS << " = "; break;
+      case Assignment::Plus_assign: *OS << " += "; break;
+      case Assignment::Minus_assign: *OS << " -= "; break;
+      case Assignment::Star_assign: *OS << " *= "; break;
+      case Assignment::Slash_assign: *OS << " /= "; break;
+      }
+      if (Node.getRightExpr())
+        Node.getRightExpr()->accept(*this);
+      else
+        Node.getRightLogic()->accept(*this);
+    }
+
+    static const char *comparisonText(Comparison::Operator Op)
+    {
+      switch (Op)
+      {
+      case Comparison::Equal: return " == ";
+      case Comparison::Not_equal: return " != ";
+      case Comparison::Greater: return " > ";
+      case Comparison::Less: return " < ";
+      case Comparison::Greater_equal: return " >= ";
+      default: return " <= ";
+      }
+    }
+
+  public:
+    PrintVisitor(llvm::raw_ostream &OS) : OS(&OS) {}
+
+    virtual void visit(Program &Node) override
+    {
+      for (llvm::SmallVector<AST *>::const_iterator I = Node.begin(), E = Node.end(); I != E; ++I)
+        statement(*I);
+    };
+
+    virtual void visit(DeclarationInt &Node) override
+    {
+      *OS << "int ";
+      llvm::SmallVector<Expr *>::const_iterator V = Node.valBegin();
+      for (llvm::SmallVector<llvm::StringRef>::const_iterator I = Node.varBegin(), E = Node.varEnd(); I != E; ++I, ++V)
+      {
+        if (I != Node.varBegin())
+          *OS << ", ";
+        *OS << *I << " = ";
+        (*V)->accept(*this);
+      }
+    };
+
+    virtual void visit(DeclarationBool &Node) override
+    {
+      *OS << "bool ";
+      llvm::SmallVector<Logic *>::const_iterator V = Node.valBegin();
+      for (llvm::SmallVector<llvm::StringRef>::const_iterator I = Node.varBegin(), E = Node.varEnd(); I != E; ++I, ++V)
+      {
+        if (I != Node.varBegin())
+          *OS << ", ";
+        *OS << *I << " = ";
+        (*V)->accept(*this);
+      }
+    };
+
+    virtual void visit(Assignment &Node) override
+    {
+      assignment(Node);
+    };
+
+    virtual void visit(Final &Node) override
+    {
+      *OS << Node.getVal();
+    };
+
+    virtual void visit(BinaryOp &Node) override
+    {
+      // ^ is right associative, the other operators are left associative
+      int Level = level(&Node);
+      bool RightAssoc = Node.getOperator() == BinaryOp::Exp;
+      int Left = level(Node.getLeft()), Right = level(Node.getRight());
+      operand(Node.getLeft(), RightAssoc ? Left <= Level : Left < Level);
+      switch (Node.getOperator())
+      {
+      case BinaryOp::Plus: *OS << " + "; break;
+      case BinaryOp::Minus: *OS << " - "; break;
+      case BinaryOp::Mul: *OS << " * "; break;
+      case BinaryOp::Div: *OS << " / "; break;
+      case BinaryOp::Mod: *OS << " % "; break;
+      case BinaryOp::Exp: *OS << " ^ "; break;
+      }
+      operand(Node.getRight(), RightAssoc ? Right < Level : Right <= Level);
+    };
+
+    virtual void visit(UnaryOp &Node) override
+    {
+      *OS << Node.getIdent() << (Node.getOperator() == UnaryOp::Plus_plus ? "++" : "--");
+    };
+
+    virtual void visit(SignedNumber &Node) override
+    {
+      *OS << (Node.getSign() == SignedNumber::Minus ? "-" : "+") << Node.getValue();
+    };
+
+    virtual void visit(NegExpr &Node) override
+    {
+      *OS << "-(";
+      Node.getExpr()->accept(*this);
+      *OS << ")";
+    };
+
+    virtual void visit(Comparison &Node) override
+    {
+      switch (Node.getOperator())
+      {
+      case Comparison::True:
+        *OS << "true";
+        return;
+      case Comparison::False:
+        *OS << "false";
+        return;
+      case Comparison::Ident:
+        Node.getLeft()->accept(*this);
+        return;
+      default:
+        break;
+      }
+      // a comparison that starts with a parenthesis is read as a parenthesized condition
+      std::string Left = render(Node.getLeft());
+      std::string Right = render(Node.getRight());
+      if (Left[0] != '(')
+        *OS << Left << comparisonText(Node.getOperator()) << Right;
+      else if (Right[0] != '(')
+        *OS << Right << comparisonText(mirror(Node.getOperator())) << Left;
+      else
+        *OS << "0 + " << Left << comparisonText(Node.getOperator()) << Right;
+    };
+
+    virtual void visit(LogicalExpr &Node) override
+    {
+      // and/or are left associative without precedence
+      Node.getLeft()->accept(*this);
+      *OS << (Node.getOperator() == LogicalExpr::And ? " and " : " or ");
+      bool Paren = level(Node.getRight()) == Precedence::Logical;
+      if (Paren)
+        *OS << "(";
+      Node.getRight()->accept(*this);
+      if (Paren)
+        *OS << ")";
+    };
+
+    virtual void visit(IfStmt &Node) override
+    {
+      // every arm can use a variable of any of the conditions
+      FirstVariable Var;
+      Var.find(Node.getCond());
+      for (llvm::SmallVector<elifStmt *>::const_iterator I = Node.beginElif(), E = Node.endElif(); I != E; ++I)
+        Var.find((*I)->getCond());
+      *OS << "if (";
+      Node.getCond()->accept(*this);
+      *OS << ") ";
+      body(Node.begin(), Node.end(), Var.Name);
+      for (llvm::SmallVector<elifStmt *>::const_iterator I = Node.beginElif(), E = Node.endElif(); I != E; ++I)
+      {
+        *OS << " else if (";
+        (*I)->getCond()->accept(*this);
+        *OS << ") ";
+        body((*I)->begin(), (*I)->end(), Var.Name);
+      }
+      if (Node.beginElse() != Node.endElse())
+      {
+        *OS << " else ";
+        body(Node.beginElse(), Node.endElse(), Var.Name);
+      }
+    };
+
+    virtual void visit(elifStmt &Node) override {};
+
+    virtual void visit(WhileStmt &Node) override
+    {
+      FirstVariable Var;
+      Var.find(Node.getCond());
+      *OS << "while (";
+      Node.getCond()->accept(*this);
+      *OS << ") ";
+      body(Node.begin(), Node.end(), Var.Name);
+    };
+
+    virtual void visit(ForStmt &Node) override
+    {
+      *OS << "for (";
+      assignment(*Node.getFirst());
+      *OS << "; ";
+      Node.getSecond()->accept(*this);
+      *OS << "; ";
+      if (Node.getThirdAssign())
+        assignment(*Node.getThirdAssign());
+      else
+        Node.getThirdUnary()->accept(*this);
+      *OS << ") ";
+      body(Node.begin(), Node.end(), Node.getFirst()->getLeft()->getVal());
+    };
+
+    virtual void visit(PrintStmt &Node) override
+    {
+      *OS << "print(" << Node.getVar() << ")";
+    };
+  };
+}
+
+void ASTPrinter::print(Program *Tree, llvm::raw_ostream &OS)
+{
+  if (!Tree)
+    return;
+  printer::PrintVisitor Printer(OS);
+  Tree->accept(Printer);
+}
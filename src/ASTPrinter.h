@@ -0,0 +1,18 @@
+#ifndef ASTPRINTER_H
+#define ASTPRINTER_H
+
+#include "AST.h"
+#include "llvm/Support/raw_ostream.h"
+
+// Writes a program back as source text, one statement per line.
+// Only the parentheses the parser needs are printed, so the text parses
+// back into the same tree. A body the optimizations emptied is printed as
+// x = x; with a variable of the condition or the loop counter; the text
+// does not parse if the conditions of the statement read no variable.
+class ASTPrinter
+{
+public:
+  void print(Program *Tree, llvm::raw_ostream &OS);
+};
+
+#endif
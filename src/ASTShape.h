@@ -0,0 +1,216 @@
+#ifndef ASTSHAPE_H
+#define ASTSHAPE_H
+
+#include "AST.h"
+#include "ConstantFolder.h"
+#include <cstdint>
+
+// What kind of node a statement, expression or condition is, and its parts.
+// Shape(nullptr) is Other.
+class Shape : public ASTVisitor
+{
+public:
+  enum
+  {
+    Other,
+    Literal,                        // a number, Value holds it
+    Variable,                       // Name holds it
+    Binary,                         // Op, Wraps, Left and Right hold it
+    Negation,                       // Left holds the negated expression
+    Constant,                       // true or false, Value holds 1 or 0
+    BoolVariable,                   // a lone bool variable, Name holds it
+    Compare,                        // CmpOp, Left and Right hold it
+    Logical,                        // LogicOp, LeftCond and RightCond hold it
+    Statement                       // Unary, Assign, While or For holds it
+  };
+  int Kind = Other;
+  int Value = 0;
+  llvm::StringRef Name;
+  BinaryOp::Operator Op;
+  bool Wraps = false;
+  Comparison::Operator CmpOp;
+  LogicalExpr::Operator LogicOp;
+  Expr *Left = nullptr;
+  Expr *Right = nullptr;
+  Logic *LeftCond = nullptr;
+  Logic *RightCond = nullptr;
+  UnaryOp *Unary = nullptr;
+  Assignment *Assign = nullptr;
+  WhileStmt *While = nullptr;
+  ForStmt *For = nullptr;
+
+  Shape(AST *Node)
+  {
+    if (Node)
+      Node->accept(*this);
+  }
+
+  virtual void visit(Final &Node) override
+  {
+    if (Node.getKind() == Final::Ident)
+    {
+      Kind = Variable;
+      Name = Node.getVal();
+    }
+    else if (ConstantFolder::number(Node.getVal(), Value))
+      Kind = Literal;
+  };
+
+  virtual void visit(SignedNumber &Node) override
+  {
+    if (ConstantFolder::signedNumber(Node.getSign(), Node.getValue(), Value))
+      Kind = Literal;
+  };
+
+  virtual void visit(BinaryOp &Node) override
+  {
+    Kind = Binary;
+    Op = Node.getOperator();
+    Wraps = Node.wraps();
+    Left = Node.getLeft();
+    Right = Node.getRight();
+  };
+
+  virtual void visit(NegExpr &Node) override
+  {
+    Kind = Negation;
+    Left = Node.getExpr();
+  };
+
+  virtual void visit(Comparison &Node) override
+  {
+    switch (Node.getOperator())
+    {
+    case Comparison::True:
+    case Comparison::False:
+      Kind = Constant;
+      Value = Node.getOperator() == Comparison::True;
+      break;
+    case Comparison::Ident:
+      Kind = BoolVariable;
+      Name = Shape(Node.getLeft()).Name;
+      break;
+    default:
+      Kind = Compare;
+      CmpOp = Node.getOperator();
+      Left = Node.getLeft();
+      Right = Node.getRight();
+      break;
+    }
+  };
+
+  virtual void visit(LogicalExpr &Node) override
+  {
+    Kind = Logical;
+    LogicOp = Node.getOperator();
+    LeftCond = Node.getLeft();
+    RightCond = Node.getRight();
+  };
+
+  virtual void visit(UnaryOp &Node) override
+  {
+    Kind = Statement;
+    Unary = &Node;
+  };
+
+  virtual void visit(Assignment &Node) override
+  {
+    Kind = Statement;
+    Assign = &Node;
+  };
+
+  virtual void visit(WhileStmt &Node) override
+  {
+    Kind = Statement;
+    While = &Node;
+  };
+
+  virtual void visit(ForStmt &Node) override
+  {
+    Kind = Statement;
+    For = &Node;
+  };
+
+  virtual void visit(DeclarationInt &Node) override {};
+  virtual void visit(DeclarationBool &Node) override {};
+  virtual void visit(IfStmt &Node) override {};
+  virtual void visit(elifStmt &Node) override {};
+  virtual void visit(PrintStmt &Node) override {};
+};
+
+// Structural equality of expressions, conditions and counter steps without
+// side effects
+inline bool same(AST *A, AST *B)
+{
+  if (!A || !B)
+    return A == B;
+  Shape L(A), R(B);
+  if (L.Kind != R.Kind)
+    return false;
+  switch (L.Kind)
+  {
+  case Shape::Literal:
+  case Shape::Constant:
+    return L.Value == R.Value;
+  case Shape::Variable:
+  case Shape::BoolVariable:
+    return L.Name == R.Name;
+  case Shape::Binary:
+    return L.Op == R.Op && L.Wraps == R.Wraps && same(L.Left, R.Left) && same(L.Right, R.Right);
+  case Shape::Negation:
+    return same(L.Left, R.Left);
+  case Shape::Compare:
+    return L.CmpOp == R.CmpOp && same(L.Left, R.Left) && same(L.Right, R.Right);
+  case Shape::Logical:
+    return L.LogicOp == R.LogicOp && same(L.LeftCond, R.LeftCond) && same(L.RightCond, R.RightCond);
+  case Shape::Statement:
+    if (L.Unary && R.Unary)
+      return L.Unary->getOperator() == R.Unary->getOperator() && L.Unary->getIdent() == R.Unary->getIdent();
+    if (L.Assign && R.Assign)
+      return L.Assign->getAssignKind() == R.Assign->getAssignKind() &&
+             L.Assign->getLeft()->getVal() == R.Assign->getLeft()->getVal() &&
+             same(L.Assign->getRightExpr(), R.Assign->getRightExpr()) &&
+             same(L.Assign->getRightLogic(), R.Assign->getRightLogic());
+    return false;
+  default:
+    return false;
+  }
+}
+
+// The operator that compares the operands the other way round: a < b is b > a
+inline Comparison::Operator mirror(Comparison::Operator Op)
+{
+  switch (Op)
+  {
+  case Comparison::Greater: return Comparison::Less;
+  case Comparison::Less: return Comparison::Greater;
+  case Comparison::Greater_equal: return Comparison::Less_equal;
+  case Comparison::Less_equal: return Comparison::Greater_equal;
+  default: return Op;
+  }
+}
+
+// The constant step a statement adds to Var: ++, --, += or -= of a literal.
+// 0 if it is none of them.
+inline int stepOf(AST *Stmt, llvm::StringRef Var)
+{
+  Shape S(Stmt);
+  if (S.Unary)
+  {
+    if (S.Unary->getIdent() != Var)
+      return 0;
+    return S.Unary->getOperator() == UnaryOp::Plus_plus ? 1 : -1;
+  }
+  if (!S.Assign || S.Assign->getLeft()->getVal() != Var || !S.Assign->getRightExpr())
+    return 0;
+  Shape Right(S.Assign->getRightExpr());
+  if (Right.Kind != Shape::Literal)
+    return 0;
+  if (S.Assign->getAssignKind() == Assignment::Plus_assign)
+    return Right.Value;
+  if (S.Assign->getAssignKind() == Assignment::Minus_assign && Right.Value != INT32_MIN)
+    return -Right.Value;
+  return 0;
+}
+
+#endif
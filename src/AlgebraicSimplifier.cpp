@@ -0,0 +1,527 @@
+#include "AlgebraicSimplifier.h"
+#include "ASTShape.h"
+#include "ConstantFolder.h"
+#include "llvm/Support/Format.h"
+
+namespace simp{
+
+  Comparison *makeBool(bool Value)
+  {
+    return new Comparison(nullptr, nullptr, Value ? Comparison::True : Comparison::False);
+  }
+
+  // Where order puts an expression of each Shape kind
+  int rank(int Kind)
+  {
+    switch (Kind)
+    {
+    case Shape::Variable: return 0;
+    case Shape::Binary: return 1;
+    case Shape::Negation: return 2;
+    case Shape::Literal: return 3;
+    default: return 4;
+    }
+  }
+
+  // A total order on expressions without side effects: variables first, then
+  // operations, then literals, so a comparison with a literal has it on the right
+  int order(Expr *A, Expr *B)
+  {
+    Shape L(A), R(B);
+    if (L.Kind != R.Kind)
+      return rank(L.Kind) - rank(R.Kind);
+    switch (L.Kind)
+    {
+    case Shape::Literal:
+      return L.Value < R.Value ? -1 : L.Value > R.Value;
+    case Shape::Variable:
+      return L.Name.compare(R.Name);
+    case Shape::Negation:
+      return order(L.Left, R.Left);
+    case Shape::Binary:
+      if (L.Op != R.Op)
+        return L.Op - R.Op;
+      if (int First = order(L.Left, R.Left))
+        return First;
+      return order(L.Right, R.Right);
+    default:
+      return 0;
+    }
+  }
+
+  // A comparison as the set of outcomes it accepts among less, equal and greater
+  enum
+  {
+    Greater = 1,
+    Equal = 2,
+    Less = 4,
+    Always = 7
+  };
+
+  unsigned outcomes(Comparison::Operator Op)
+  {
+    switch (Op)
+    {
+    case Comparison::Less: return Less;
+    case Comparison::Less_equal: return Less | Equal;
+    case Comparison::Equal: return Equal;
+    case Comparison::Not_equal: return Less | Greater;
+    case Comparison::Greater_equal: return Greater | Equal;
+    default: return Greater;
+    }
+  }
+
+  Comparison::Operator comparison(unsigned Outcomes)
+  {
+    switch (Outcomes)
+    {
+    case Less: return Comparison::Less;
+    case Less | Equal: return Comparison::Less_equal;
+    case Equal: return Comparison::Equal;
+    case Less | Greater: return Comparison::Not_equal;
+    case Greater | Equal: return Comparison::Greater_equal;
+    default: return Comparison::Greater;
+    }
+  }
+
+  // The outcomes with the operands swapped
+  unsigned mirror(unsigned Outcomes)
+  {
+    return (Outcomes & Equal) | (Outcomes & Less ? Greater : 0) | (Outcomes & Greater ? Less : 0);
+  }
+
+  // A binary operation or negation whose operands are simplified already
+  struct Operation
+  {
+    bool Negation;                  // -(Left), otherwise Left Op Right
+    BinaryOp::Operator Op;
+    Expr *Left;
+    Expr *Right;
+    bool Pure;                      // neither operand contains ++ or --
+    bool LeftLiteral, RightLiteral;
+    int LeftValue, RightValue;
+    Expr *Negated;                  // the operand of a negated Left
+
+    bool is(BinaryOp::Operator O) const { return !Negation && Op == O; }
+    bool leftIs(int V) const { return LeftLiteral && LeftValue == V; }
+    bool rightIs(int V) const { return RightLiteral && RightValue == V; }
+  };
+
+  // A rule returns the expression to use instead, or nullptr if it does not apply.
+  // The result is an operand, a literal or a new negation of an operand.
+  struct Rule
+  {
+    const char *Name;
+    const char *Pattern;
+    Expr *(*Apply)(const Operation &S);
+  };
+
+  const Rule Rules[] = {
+    {"add-zero", "x + 0 -> x",
+     [](const Operation &S) -> Expr * { return S.is(BinaryOp::Plus) && S.rightIs(0) ? S.Left : nullptr; }},
+    {"zero-add", "0 + x -> x",
+     [](const Operation &S) -> Expr * { return S.is(BinaryOp::Plus) && S.leftIs(0) ? S.Right : nullptr; }},
+    {"sub-zero", "x - 0 -> x",
+     [](const Operation &S) -> Expr * { return S.is(BinaryOp::Minus) && S.rightIs(0) ? S.Left : nullptr; }},
+    {"zero-sub", "0 - x -> -(x)",
+     [](const Operation &S) -> Expr * { return S.is(BinaryOp::Minus) && S.leftIs(0) ? new NegExpr(S.Right) : nullptr; }},
+    {"sub-self", "x - x -> 0",
+     [](const Operation &S) -> Expr * { return S.is(BinaryOp::Minus) && S.Pure && same(S.Left, S.Right) ? makeNumber(0) : nullptr; }},
+    {"mul-one", "x * 1 -> x",
+     [](const Operation &S) -> Expr * { return S.is(BinaryOp::Mul) && S.rightIs(1) ? S.Left : nullptr; }},
+    {"one-mul", "1 * x -> x",
+     [](const Operation &S) -> Expr * { return S.is(BinaryOp::Mul) && S.leftIs(1) ? S.Right : nullptr; }},
+    {"mul-zero", "x * 0 -> 0",
+     [](const Operation &S) -> Expr * { return S.is(BinaryOp::Mul) && S.Pure && (S.rightIs(0) || S.leftIs(0)) ? makeNumber(0) : nullptr; }},
+    {"mul-minus-one", "x * -1 -> -(x)",
+     [](const Operation &S) -> Expr * {
+       if (!S.is(BinaryOp::Mul))
+         return nullptr;
+       if (S.rightIs(-1))
+         return new NegExpr(S.Left);
+       return S.leftIs(-1) ? new NegExpr(S.Right) : nullptr;
+     }},
+    {"div-one", "x / 1 -> x",
+     [](const Operation &S) -> Expr * { return S.is(BinaryOp::Div) && S.rightIs(1) ? S.Left : nullptr; }},
+    {"div-minus-one", "x / -1 -> -(x)",
+     [](const Operation &S) -> Expr * { return S.is(BinaryOp::Div) && S.rightIs(-1) ? new NegExpr(S.Left) : nullptr; }},
+    {"mod-one", "x % 1 -> 0",
+     [](const Operation &S) -> Expr * { return S.is(BinaryOp::Mod) && S.Pure && (S.rightIs(1) || S.rightIs(-1)) ? makeNumber(0) : nullptr; }},
+    {"pow-zero", "x ^ 0 -> 1",
+     [](const Operation &S) -> Expr * { return S.is(BinaryOp::Exp) && S.Pure && S.RightLiteral && S.RightValue <= 0 ? makeNumber(1) : nullptr; }},
+    {"pow-one", "x ^ 1 -> x",
+     [](const Operation &S) -> Expr * { return S.is(BinaryOp::Exp) && S.rightIs(1) ? S.Left : nullptr; }},
+    {"neg-neg", "-(-(x)) -> x",
+     [](const Operation &S) -> Expr * { return S.Negation ? S.Negated : nullptr; }},
+    {"neg-literal", "-(c) -> -c",
+     [](const Operation &S) -> Expr * { return S.Negation && S.LeftLiteral ? makeNumber(ConstantFolder::neg(S.LeftValue)) : nullptr; }},
+  };
+
+  const unsigned NumRules = sizeof(Rules) / sizeof(Rules[0]);
+
+  // The rewrites of conditions. They are applied to whole and/or chains at once,
+  // so they are listed here only for the report.
+  enum LogicRule
+  {
+    CmpFold,
+    CmpSelf,
+    CmpOrder,
+    AndTrue,
+    AndFalse,
+    OrFalse,
+    OrTrue,
+    Duplicate,
+    Contradiction,
+    Tautology,
+    CmpMerge,
+    NumLogicRules
+  };
+
+  const Rule LogicRules[NumLogicRules] = {
+    {"cmp-fold", "1 < 2 -> true", nullptr},
+    {"cmp-self", "x <= x -> true", nullptr},
+    {"cmp-order", "3 < x -> x > 3", nullptr},
+    {"and-true", "c and true -> c", nullptr},
+    {"and-false", "c and false -> false", nullptr},
+    {"or-false", "c or false -> c", nullptr},
+    {"or-true", "c or true -> true", nullptr},
+    {"duplicate", "c and c -> c", nullptr},
+    {"contradiction", "x < y and x >= y -> false", nullptr},
+    {"tautology", "x < y or x >= y -> true", nullptr},
+    {"cmp-merge", "x < y or x == y -> x <= y", nullptr},
+  };
+
+  // Simplifies every expression bottom up, so the rules see simplified operands
+  class SimplifyVisitor : public ASTVisitor
+  {
+    llvm::SmallVectorImpl<unsigned> &Fired;
+    Expr *Result;                   // simplified form of the last visited expression
+    Logic *LogicResult;             // simplified form of the last visited condition
+    bool Pure;                      // either contains no ++ or --
+
+    Expr *simplify(Expr *E)
+    {
+      E->accept(*this);
+      return Result;
+    }
+
+    Logic *simplify(Logic *L)
+    {
+      L->accept(*this);
+      return LogicResult;
+    }
+
+    void fire(LogicRule R)
+    {
+      ++Fired[NumRules + R];
+    }
+
+    // The and/or operands of a chain of one operator, left to right
+    void flatten(Logic *L, LogicalExpr::Operator Op, llvm::SmallVectorImpl<Logic *> &Items)
+    {
+      Shape C(L);
+      if (C.Kind != Shape::Logical || C.LogicOp != Op)
+      {
+        Items.push_back(L);
+        return;
+      }
+      flatten(C.LeftCond, Op, Items);
+      if (C.RightCond)
+        flatten(C.RightCond, Op, Items);
+    }
+
+    // Folds Item into Into, which is evaluated before it in a chain of Op with
+    // nothing between them that stores a variable. False if they do not combine.
+    bool combine(Logic *&Into, Logic *Item, LogicalExpr::Operator Op)
+    {
+      if (same(Into, Item))
+      {
+        fire(Duplicate);
+        return true;
+      }
+      Shape A(Into), B(Item);
+      if (A.Kind != Shape::Compare || B.Kind != Shape::Compare)
+        return false;
+      unsigned Outcomes = outcomes(B.CmpOp);
+      if (same(A.Left, B.Right) && same(A.Right, B.Left))
+        Outcomes = mirror(Outcomes);
+      else if (!same(A.Left, B.Left) || !same(A.Right, B.Right))
+        return false;
+      if (Op == LogicalExpr::And)
+        Outcomes &= outcomes(A.CmpOp);
+      else
+        Outcomes |= outcomes(A.CmpOp);
+      if (Outcomes == 0 || Outcomes == Always)
+      {
+        fire(Outcomes ? Tautology : Contradiction);
+        Into = makeBool(Outcomes);
+      }
+      else
+      {
+        fire(CmpMerge);
+        Into = new Comparison(A.Left, A.Right, comparison(Outcomes));
+      }
+      return true;
+    }
+
+    // Applies the first rule that matches until none does
+    Expr *apply(Expr *Node, Operation S)
+    {
+      while (true)
+      {
+        Shape Left(S.Left);
+        S.LeftLiteral = Left.Kind == Shape::Literal;
+        S.LeftValue = Left.Value;
+        S.Negated = Left.Kind == Shape::Negation ? Left.Left : nullptr;
+        if (!S.Negation)
+        {
+          Shape Right(S.Right);
+          S.RightLiteral = Right.Kind == Shape::Literal;
+          S.RightValue = Right.Value;
+        }
+        Expr *Simplified = nullptr;
+        for (unsigned I = 0; I != NumRules && !Simplified; ++I)
+          if ((Simplified = Rules[I].Apply(S)))
+            ++Fired[I];
+        if (!Simplified)
+          return Node;
+        // a new negation may simplify further, operands and literals are done
+        Shape New(Simplified);
+        if (Simplified == S.Left || Simplified == S.Right || New.Kind != Shape::Negation)
+          return Simplified;
+        Node = Simplified;
+        S.Negation = true;
+        S.Left = New.Left;
+        S.Right = nullptr;
+        S.RightLiteral = false;
+      }
+    }
+
+    template <typename Iterator>
+    void all(Iterator Begin, Iterator End)
+    {
+      for (Iterator I = Begin; I != End; ++I)
+        (*I)->accept(*this);
+    }
+
+  public:
+    SimplifyVisitor(llvm::SmallVectorImpl<unsigned> &Fired) : Fired(Fired) {}
+
+    virtual void visit(Program &Node) override
+    {
+      all(Node.begin(), Node.end());
+    };
+
+    virtual void visit(DeclarationInt &Node) override
+    {
+      llvm::SmallVector<Expr *> Values;
+      for (llvm::SmallVector<Expr *>::const_iterator I = Node.valBegin(), E = Node.valEnd(); I != E; ++I)
+        Values.push_back(simplify(*I));
+      Node.setValues(Values);
+    };
+
+    virtual void visit(DeclarationBool &Node) override
+    {
+      llvm::SmallVector<Logic *> Values;
+      for (llvm::SmallVector<Logic *>::const_iterator I = Node.valBegin(), E = Node.valEnd(); I != E; ++I)
+        Values.push_back(simplify(*I));
+      Node.setValues(Values);
+    };
+
+    virtual void visit(Assignment &Node) override
+    {
+      if (Node.getRightExpr())
+        Node.setRightExpr(simplify(Node.getRightExpr()));
+      else
+        Node.setRightLogic(simplify(Node.getRightLogic()));
+    };
+
+    virtual void visit(Final &Node) override
+    {
+      Result = &Node;
+      Pure = true;
+    };
+
+    virtual void visit(BinaryOp &Node) override
+    {
+      Operation S;
+      S.Negation = false;
+      S.Op = Node.getOperator();
+      S.Left = simplify(Node.getLeft());
+      bool LeftPure = Pure;
+      S.Right = simplify(Node.getRight());
+      S.Pure = LeftPure && Pure;
+      Node.setLeft(S.Left);
+      Node.setRight(S.Right);
+      Pure = S.Pure;
+      Result = apply(&Node, S);
+    };
+
+    virtual void visit(UnaryOp &Node) override
+    {
+      Result = &Node;
+      Pure = false;
+    };
+
+    virtual void visit(SignedNumber &Node) override
+    {
+      Result = &Node;
+      Pure = true;
+    };
+
+    virtual void visit(NegExpr &Node) override
+    {
+      Operation S;
+      S.Negation = true;
+      S.Left = simplify(Node.getExpr());
+      S.Right = nullptr;
+      S.RightLiteral = false;
+      S.Pure = Pure;
+      Node.setExpr(S.Left);
+      Result = apply(&Node, S);
+    };
+
+    virtual void visit(Comparison &Node) override
+    {
+      LogicResult = &Node;
+      Pure = true;
+      if (!Node.getRight())
+        return;
+      Expr *Left = simplify(Node.getLeft());
+      bool LeftPure = Pure;
+      Expr *Right = simplify(Node.getRight());
+      Pure = LeftPure && Pure;
+      Node.setLeft(Left);
+      Node.setRight(Right);
+      if (!Pure)
+        return;
+      Shape L(Left), R(Right);
+      if (L.Kind == Shape::Literal && R.Kind == Shape::Literal)
+      {
+        fire(CmpFold);
+        LogicResult = makeBool(ConstantFolder::comparison(Node.getOperator(), L.Value, R.Value));
+      }
+      else if (same(Left, Right))
+      {
+        fire(CmpSelf);
+        LogicResult = makeBool(outcomes(Node.getOperator()) & Equal);
+      }
+      else if (order(Left, Right) > 0)
+      {
+        // the same test with the operands the other way round compares equal
+        fire(CmpOrder);
+        LogicResult = new Comparison(Right, Left, comparison(mirror(outcomes(Node.getOperator()))));
+      }
+    };
+
+    // Both operands of and/or are always evaluated, so an operand that stores
+    // a variable is kept in its place and nothing is combined across it.
+    virtual void visit(LogicalExpr &Node) override
+    {
+      LogicalExpr::Operator Op = Node.getOperator();
+      int Identity = Op == LogicalExpr::And;
+      llvm::SmallVector<Logic *> Items, Kept;
+      llvm::SmallVector<bool> KeptPure;
+      flatten(&Node, Op, Items);
+      bool AllPure = true, Absorbed = false;
+      for (Logic *Item : Items)
+      {
+        Item = simplify(Item);
+        AllPure &= Pure;
+        Shape C(Item);
+        if (C.Kind == Shape::Constant && C.Value == Identity)
+        {
+          fire(Op == LogicalExpr::And ? AndTrue : OrFalse);
+          continue;
+        }
+        bool Combined = false;
+        if (Pure)
+          for (unsigned I = Kept.size(); I-- != 0 && KeptPure[I] && !Combined;)
+            Combined = combine(Kept[I], Item, Op);
+        if (Combined)
+          continue;
+        Kept.push_back(Item);
+        KeptPure.push_back(Pure);
+      }
+      // a combined comparison may have become the absorbing or identity constant
+      for (Logic *Item : Kept)
+      {
+        Shape C(Item);
+        Absorbed |= C.Kind == Shape::Constant && C.Value != Identity;
+      }
+      if (Absorbed)
+        fire(Op == LogicalExpr::And ? AndFalse : OrTrue);
+      llvm::SmallVector<Logic *> Chain;
+      for (unsigned I = 0; I != Kept.size(); ++I)
+      {
+        Shape C(Kept[I]);
+        if (C.Kind == Shape::Constant && C.Value == Identity)
+          fire(Op == LogicalExpr::And ? AndTrue : OrFalse);
+        // once the result is known only the operands that store a variable are needed
+        else if (!Absorbed || (!KeptPure[I] && C.Kind != Shape::Constant))
+          Chain.push_back(Kept[I]);
+      }
+      if (Absorbed)
+        Chain.push_back(makeBool(!Identity));
+      Pure = AllPure;
+      if (Chain.empty())
+      {
+        LogicResult = makeBool(Identity);
+        return;
+      }
+      LogicResult = Chain.front();
+      for (unsigned I = 1; I != Chain.size(); ++I)
+        LogicResult = new LogicalExpr(LogicResult, Chain[I], Op);
+    };
+
+    virtual void visit(IfStmt &Node) override
+    {
+      Node.setCond(simplify(Node.getCond()));
+      all(Node.begin(), Node.end());
+      all(Node.beginElif(), Node.endElif());
+      all(Node.beginElse(), Node.endElse());
+    };
+
+    virtual void visit(elifStmt &Node) override
+    {
+      Node.setCond(simplify(Node.getCond()));
+      all(Node.begin(), Node.end());
+    };
+
+    virtual void visit(WhileStmt &Node) override
+    {
+      Node.setCond(simplify(Node.getCond()));
+      all(Node.begin(), Node.end());
+    };
+
+    virtual void visit(ForStmt &Node) override
+    {
+      Node.getFirst()->accept(*this);
+      Node.setSecond(simplify(Node.getSecond()));
+      if (Node.getThirdAssign())
+        Node.getThirdAssign()->accept(*this);
+      all(Node.begin(), Node.end());
+    };
+
+    virtual void visit(PrintStmt &Node) override {};
+  };
+}
+
+void AlgebraicSimplifier::optimize(Program *Tree)
+{
+  if (!Tree)
+    return;
+  Fired.assign(simp::NumRules + simp::NumLogicRules, 0);
+  simp::SimplifyVisitor Simplifier(Fired);
+  Tree->accept(Simplifier);
+}
+
+void AlgebraicSimplifier::report(llvm::raw_ostream &OS)
+{
+  for (unsigned I = 0; I != Fired.size(); ++I)
+  {
+    const simp::Rule &R = I < simp::NumRules ? simp::Rules[I] : simp::LogicRules[I - simp::NumRules];
+    if (Fired[I])
+      OS << llvm::format("  %-14s %-26s %8u\n", R.Name, R.Pattern, Fired[I]);
+  }
+}
@@ -0,0 +1,37 @@
+#ifndef ALGEBRAICSIMPLIFIER_H
+#define ALGEBRAICSIMPLIFIER_H
+
+#include "AST.h"
+#include "ASTPass.h"
+#include "llvm/ADT/SmallVector.h"
+
+// Rule-based simplification of arithmetic.
+// Expressions are rewritten bottom up with a table of rules such as
+// x + 0 -> x, x - x -> 0 and -(-x) -> x; a rule is only in the table if
+// the IR CodeGen emits for its result gives the same value for every
+// input that does not already overflow. The number of times each rule
+// fired is printed in the pass report. Multiplications, divisions and
+// remainders by powers of two are left to CodeGen, which emits them as
+// shifts and masks since the language has no operators for those.
+// Conditions are canonicalized as well: comparisons of literals and of an
+// operand with itself fold to true or false, and operands are ordered
+// with variables first and literals last, so 3 < a becomes a > 3. In an
+// and/or chain true and false operands are folded away, repeated operands
+// dropped and two comparisons of the same operands merged, so
+// x < y and x >= y becomes false and x < y or x == y becomes x <= y.
+class AlgebraicSimplifier : public ASTPass
+{
+  llvm::SmallVector<unsigned> Fired; // per rule of the tables
+
+public:
+  void optimize(Program *Tree);
+
+  virtual void visit(Program &Node) override
+  {
+    optimize(&Node);
+  };
+
+  virtual void report(llvm::raw_ostream &OS) override;
+};
+
+#endif
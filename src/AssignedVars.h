@@ -0,0 +1,122 @@
+#ifndef ASSIGNEDVARS_H
+#define ASSIGNEDVARS_H
+
+#include "AST.h"
+#include "llvm/ADT/StringSet.h"
+
+// Collects every variable a statement, condition or expression may assign
+class AssignedVars : public ASTVisitor
+{
+  llvm::StringSet<> &Vars;
+
+public:
+  AssignedVars(llvm::StringSet<> &Vars) : Vars(Vars) {}
+
+  virtual void visit(Program &Node) override
+  {
+    for (llvm::SmallVector<AST *>::const_iterator I = Node.begin(), E = Node.end(); I != E; ++I)
+      (*I)->accept(*this);
+  };
+
+  virtual void visit(Final &Node) override {};
+
+  virtual void visit(BinaryOp &Node) override
+  {
+    Node.getLeft()->accept(*this);
+    Node.getRight()->accept(*this);
+  };
+
+  virtual void visit(UnaryOp &Node) override
+  {
+    Vars.insert(Node.getIdent());
+  };
+
+  virtual void visit(SignedNumber &Node) override {};
+
+  virtual void visit(NegExpr &Node) override
+  {
+    Node.getExpr()->accept(*this);
+  };
+
+  virtual void visit(Assignment &Node) override
+  {
+    Vars.insert(Node.getLeft()->getVal());
+    if (Node.getRightExpr())
+      Node.getRightExpr()->accept(*this);
+    else
+      Node.getRightLogic()->accept(*this);
+  };
+
+  virtual void visit(DeclarationInt &Node) override
+  {
+    for (llvm::SmallVector<Expr *>::const_iterator I = Node.valBegin(), E = Node.valEnd(); I != E; ++I)
+      (*I)->accept(*this);
+    for (llvm::SmallVector<llvm::StringRef>::const_iterator I = Node.varBegin(), E = Node.varEnd(); I != E; ++I)
+      Vars.insert(*I);
+  };
+
+  virtual void visit(DeclarationBool &Node) override
+  {
+    for (llvm::SmallVector<Logic *>::const_iterator I = Node.valBegin(), E = Node.valEnd(); I != E; ++I)
+      (*I)->accept(*this);
+    for (llvm::SmallVector<llvm::StringRef>::const_iterator I = Node.varBegin(), E = Node.varEnd(); I != E; ++I)
+      Vars.insert(*I);
+  };
+
+  virtual void visit(Comparison &Node) override
+  {
+    if (Node.getLeft())
+      Node.getLeft()->accept(*this);
+    if (Node.getRight())
+      Node.getRight()->accept(*this);
+  };
+
+  virtual void visit(LogicalExpr &Node) override
+  {
+    if (Node.getLeft())
+      Node.getLeft()->accept(*this);
+    if (Node.getRight())
+      Node.getRight()->accept(*this);
+  };
+
+  virtual void visit(IfStmt &Node) override
+  {
+    Node.getCond()->accept(*this);
+    for (llvm::SmallVector<AST *>::const_iterator I = Node.begin(), E = Node.end(); I != E; ++I)
+      (*I)->accept(*this);
+    for (llvm::SmallVector<elifStmt *>::const_iterator I = Node.beginElif(), E = Node.endElif(); I != E; ++I)
+      (*I)->accept(*this);
+    for (llvm::SmallVector<AST *>::const_iterator I = Node.beginElse(), E = Node.endElse(); I != E; ++I)
+      (*I)->accept(*this);
+  };
+
+  virtual void visit(elifStmt &Node) override
+  {
+    Node.getCond()->accept(*this);
+    for (llvm::SmallVector<AST *>::const_iterator I = Node.begin(), E = Node.end(); I != E; ++I)
+      (*I)->accept(*this);
+  };
+
+  virtual void visit(WhileStmt &Node) override
+  {
+    Node.getCond()->accept(*this);
+    for (llvm::SmallVector<AST *>::const_iterator I = Node.begin(), E = Node.end(); I != E; ++I)
+      (*I)->accept(*this);
+  };
+
+  virtual void visit(ForStmt &Node) override
+  {
+    Node.getFirst()->accept(*this);
+    Node.getSecond()->accept(*this);
+    if (Node.getThirdAssign())
+      Node.getThirdAssign()->accept(*this);
+    else
+      Node.getThirdUnary()->accept(*this);
+    for (llvm::SmallVector<AST *>::const_iterator I = Node.begin(), E = Node.end(); I != E; ++I)
+      (*I)->accept(*this);
+  };
+
+  virtual void visit(PrintStmt &Node) override {};
+};
+
+#endif
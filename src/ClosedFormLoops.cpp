@@ -0,0 +1,492 @@
+#include "ClosedFormLoops.h"
+#include "ASTCloner.h"
+#include "ASTShape.h"
+#include "AssignedVars.h"
+#include "ConstProp.h"
+#include "ConstantFolder.h"
+#include "StmtRewriter.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/Format.h"
+#include <cstdint>
+
+namespace iv{
+
+  // + - * modulo 2^32, as the sums of the loop are
+  Expr *wrapping(BinaryOp::Operator Op, Expr *Left, Expr *Right)
+  {
+    return new BinaryOp(Op, Left, Right, true);
+  }
+
+  // An expression of the loop as Inv + Coef * i + SelfCoef * s, where s is
+  // the variable a statement assigns and Inv (nullptr for 0) reads no
+  // variable the loop assigns. Inv may share nodes with the loop.
+  class Affine : public ASTVisitor
+  {
+    llvm::StringRef Counter, Self;
+    const llvm::StringSet<> &Assigned;
+
+    bool linear()
+    {
+      return Coef || SelfCoef;
+    }
+
+  public:
+    bool Valid = true;
+    Expr *Inv = nullptr;
+    int64_t Coef = 0;
+    int64_t SelfCoef = 0;
+
+    Affine(llvm::StringRef Counter, llvm::StringRef Self, const llvm::StringSet<> &Assigned)
+        : Counter(Counter), Self(Self), Assigned(Assigned) {}
+
+    bool parse(Expr *E)
+    {
+      Valid = true;
+      Inv = nullptr;
+      Coef = SelfCoef = 0;
+      E->accept(*this);
+      return Valid && Coef >= INT32_MIN && Coef <= INT32_MAX && SelfCoef >= INT32_MIN && SelfCoef <= INT32_MAX;
+    }
+
+    virtual void visit(Final &Node) override
+    {
+      if (Node.getKind() != Final::Ident)
+        Inv = &Node;
+      else if (Node.getVal() == Counter)
+        Coef = 1;
+      else if (Node.getVal() == Self)
+        SelfCoef = 1;
+      else if (Assigned.count(Node.getVal()))
+        Valid = false;
+      else
+        Inv = &Node;
+    };
+
+    virtual void visit(SignedNumber &Node) override
+    {
+      Inv = &Node;
+    };
+
+    virtual void visit(NegExpr &Node) override
+    {
+      Affine Sub(Counter, Self, Assigned);
+      Valid = Sub.parse(Node.getExpr());
+      if (!Sub.linear())
+      {
+        Inv = &Node;
+        return;
+      }
+      Inv = Sub.Inv ? wrapping(BinaryOp::Minus, makeNumber(0), Sub.Inv) : nullptr;
+      Coef = -Sub.Coef;
+      SelfCoef = -Sub.SelfCoef;
+    };
+
+    virtual void visit(BinaryOp &Node) override
+    {
+      Affine Left(Counter, Self, Assigned), Right(Counter, Self, Assigned);
+      Valid = Left.parse(Node.getLeft()) && Right.parse(Node.getRight());
+      if (!Valid)
+        return;
+      if (!Left.linear() && !Right.linear())
+      {
+        Inv = &Node;                // computed once instead of in every iteration
+        return;
+      }
+      switch (Node.getOperator())
+      {
+      case BinaryOp::Plus:
+        Inv = Left.Inv ? (Right.Inv ? wrapping(BinaryOp::Plus, Left.Inv, Right.Inv) : Left.Inv) : Right.Inv;
+        Coef = Left.Coef + Right.Coef;
+        SelfCoef = Left.SelfCoef + Right.SelfCoef;
+        return;
+      case BinaryOp::Minus:
+        if (Left.Inv)
+          Inv = Right.Inv ? wrapping(BinaryOp::Minus, Left.Inv, Right.Inv) : Left.Inv;
+        else
+          Inv = Right.Inv ? wrapping(BinaryOp::Minus, makeNumber(0), Right.Inv) : nullptr;
+        Coef = Left.Coef - Right.Coef;
+        SelfCoef = Left.SelfCoef - Right.SelfCoef;
+        return;
+      case BinaryOp::Mul:
+      {
+        // only a multiple of i or s by a literal stays affine
+        Shape LeftShape(Node.getLeft()), RightShape(Node.getRight());
+        if (LeftShape.Kind != Shape::Literal && RightShape.Kind != Shape::Literal)
+          break;
+        Affine &Scaled = RightShape.Kind == Shape::Literal ? Left : Right;
+        int Factor = RightShape.Kind == Shape::Literal ? RightShape.Value : LeftShape.Value;
+        Inv = Scaled.Inv ? wrapping(BinaryOp::Mul, Scaled.Inv, makeNumber(Factor)) : nullptr;
+        Coef = Scaled.Coef * Factor;
+        SelfCoef = Scaled.SelfCoef * Factor;
+        return;
+      }
+      default:
+        break;
+      }
+      Valid = false;
+    };
+
+    virtual void visit(UnaryOp &Node) override { Valid = false; };
+    virtual void visit(Assignment &Node) override { Valid = false; };
+    virtual void visit(DeclarationInt &Node) override { Valid = false; };
+    virtual void visit(DeclarationBool &Node) override { Valid = false; };
+    virtual void visit(Comparison &Node) override { Valid = false; };
+    virtual void visit(LogicalExpr &Node) override { Valid = false; };
+    virtual void visit(IfStmt &Node) override { Valid = false; };
+    virtual void visit(WhileStmt &Node) override { Valid = false; };
+    virtual void visit(elifStmt &Node) override { Valid = false; };
+    virtual void visit(ForStmt &Node) override { Valid = false; };
+    virtual void visit(PrintStmt &Node) override { Valid = false; };
+  };
+
+  // What one statement of the body does to a variable in every iteration
+  struct Update
+  {
+    llvm::StringRef Var;
+    bool Store;                     // x = e rather than s += e
+    bool Subtract;                  // s -= e
+    bool AfterStep;                 // the counter was stepped already
+    Expr *Inv;
+    int64_t Coef;
+  };
+
+  // A loop whose counter steps from Start by Step while it is below
+  // (above for a negative step) Bound
+  struct CountingLoop
+  {
+    llvm::StringRef Counter;
+    Expr *Start;
+    Expr *Bound;
+    int Step = 0;
+    bool Strict;                    // < or >, not <= or >=
+    llvm::SmallVector<Update, 4> Updates;
+  };
+
+  // An expression that reads neither the counter nor a variable the loop assigns
+  bool invariant(Expr *E, llvm::StringRef Counter, const llvm::StringSet<> &Assigned)
+  {
+    Affine Parser(Counter, "", Assigned);
+    return Parser.parse(E) && Parser.Inv == E;
+  }
+
+  bool update(AST *Stmt, llvm::StringRef Counter, const llvm::StringSet<> &Assigned, Update &U)
+  {
+    Shape S(Stmt);
+    U.Store = U.Subtract = false;
+    if (S.Unary)
+    {
+      U.Var = S.Unary->getIdent();
+      U.Subtract = S.Unary->getOperator() == UnaryOp::Minus_minus;
+      U.Inv = makeNumber(1);
+      U.Coef = 0;
+      return true;
+    }
+    if (!S.Assign || !S.Assign->getRightExpr())
+      return false;
+    U.Var = S.Assign->getLeft()->getVal();
+    Affine Parser(Counter, U.Var, Assigned);
+    if (!Parser.parse(S.Assign->getRightExpr()))
+      return false;
+    switch (S.Assign->getAssignKind())
+    {
+    case Assignment::Plus_assign:
+    case Assignment::Minus_assign:
+      U.Subtract = S.Assign->getAssignKind() == Assignment::Minus_assign;
+      if (Parser.SelfCoef)
+        return false;
+      break;
+    case Assignment::Assign:
+      // s = s + e accumulates, x = e stores
+      if (Parser.SelfCoef != 0 && Parser.SelfCoef != 1)
+        return false;
+      U.Store = !Parser.SelfCoef;
+      break;
+    default:
+      return false;
+    }
+    U.Inv = Parser.Inv;
+    U.Coef = Parser.Coef;
+    return true;
+  }
+
+  // Reads the counter, the bound and the body of a loop, whose counter is
+  // already known for a for loop
+  bool countingLoop(Logic *Cond, llvm::ArrayRef<AST *> Body, CountingLoop &Loop)
+  {
+    llvm::StringSet<> Assigned;
+    AssignedVars Collector(Assigned);
+    for (AST *Stmt : Body)
+      Stmt->accept(Collector);
+
+    Shape C(Cond);
+    if (C.Kind != Shape::Compare)
+      return false;
+    Shape L(C.Left), R(C.Right);
+    Comparison::Operator Op = C.CmpOp;
+    if (Loop.Counter.empty())
+      Loop.Counter = !L.Name.empty() && Assigned.count(L.Name) ? L.Name : R.Name;
+    if (Loop.Counter.empty())
+      return false;
+    if (L.Name == Loop.Counter)
+      Loop.Bound = C.Right;
+    else if (R.Name == Loop.Counter)
+    {
+      Loop.Bound = C.Left;
+      Op = mirror(Op);
+    }
+    else
+      return false;
+    if (!invariant(Loop.Bound, Loop.Counter, Assigned))
+      return false;
+
+    // a while loop steps the counter in its body, once
+    llvm::StringSet<> Seen;
+    bool AfterStep = false;
+    for (AST *Stmt : Body)
+    {
+      if (int Step = stepOf(Stmt, Loop.Counter))
+      {
+        if (Loop.Step)
+          return false;
+        Loop.Step = Step;
+        AfterStep = true;
+        continue;
+      }
+      Update U;
+      if (!update(Stmt, Loop.Counter, Assigned, U) || U.Var == Loop.Counter || !Seen.insert(U.Var).second)
+        return false;
+      U.AfterStep = AfterStep;
+      Loop.Updates.push_back(U);
+    }
+    if (!Loop.Step)
+      return false;
+
+    switch (Op)
+    {
+    case Comparison::Less:
+    case Comparison::Less_equal:
+      if (Loop.Step < 0)
+        return false;
+      break;
+    case Comparison::Greater:
+    case Comparison::Greater_equal:
+      if (Loop.Step > 0)
+        return false;
+      break;
+    case Comparison::Not_equal:
+      // only reaches the bound if it steps by one
+      if (Loop.Step != 1 && Loop.Step != -1)
+        return false;
+      break;
+    default:
+      return false;
+    }
+    Loop.Strict = Op != Comparison::Less_equal && Op != Comparison::Greater_equal;
+    return true;
+  }
+
+  // Rebuilds every statement list with the counting loops in it replaced,
+  // innermost loops first
+  class ClosedFormVisitor : public StmtRewriter
+  {
+    unsigned &Replaced, &Guarded;
+    ASTCloner Cloner;
+
+    // Appends the closed form of the loop, or the loop itself if its trip
+    // count may not fit. Loop.Start and Loop.Bound are not changed by it.
+    void replace(AST &Node, Logic *Cond, CountingLoop &Loop)
+    {
+      bool Up = Loop.Step > 0;
+      int64_t Stride = Up ? Loop.Step : -(int64_t)Loop.Step;
+      Expr *Hi = Up ? Loop.Bound : Loop.Start;
+      Expr *Lo = Up ? Loop.Start : Loop.Bound;
+      Shape HiShape(Hi), LoShape(Lo);
+
+      // trips = (Hi - Lo - Strict) / Stride + 1 when Hi - Lo - Strict >= 0,
+      // which can not wrap if Lo >= 0 or Hi < 0
+      Expr *Trips;
+      bool Known = HiShape.Kind == Shape::Literal && LoShape.Kind == Shape::Literal;
+      int64_t KnownTrips = 0;
+      if (Known)
+      {
+        int64_t Distance = (int64_t)HiShape.Value - LoShape.Value - Loop.Strict;
+        if (Distance < 0)
+        {
+          ++Replaced;               // it never runs
+          return;
+        }
+        KnownTrips = Distance / Stride + 1;
+        if (KnownTrips > INT32_MAX)
+        {
+          Out.push_back(&Node);
+          return;
+        }
+        Trips = makeNumber((int)KnownTrips);
+      }
+      else
+      {
+        Expr *Distance = wrapping(BinaryOp::Minus, Cloner.clone(Hi), Cloner.clone(Lo));
+        if (Stride == 1)
+          Trips = Loop.Strict ? Distance : wrapping(BinaryOp::Plus, Distance, makeNumber(1));
+        else
+        {
+          if (Loop.Strict)
+            Distance = wrapping(BinaryOp::Minus, Distance, makeNumber(1));
+          Trips = wrapping(BinaryOp::Plus, new BinaryOp(BinaryOp::Div, Distance, makeNumber((int)Stride)),
+                           makeNumber(1));
+        }
+      }
+      bool Safe = Known || (LoShape.Kind == Shape::Literal && LoShape.Value >= 0) || (HiShape.Kind == Shape::Literal && HiShape.Value < 0);
+
+      // the sum of k for k < trips, as (trips / 2) * (trips - 1 + trips % 2)
+      // so that no product is halved after wrapping
+      auto HalfSquare = [&]() -> Expr * {
+        if (Known)
+        {
+          uint32_t Half = KnownTrips / 2, Odd = KnownTrips - 1 + KnownTrips % 2;
+          return makeNumber((int)(Half * Odd));
+        }
+        Expr *Half = new BinaryOp(BinaryOp::Div, Cloner.clone(Trips), makeNumber(2));
+        Expr *Odd = wrapping(BinaryOp::Plus, wrapping(BinaryOp::Minus, Cloner.clone(Trips), makeNumber(1)),
+                             new BinaryOp(BinaryOp::Mod, Cloner.clone(Trips), makeNumber(2)));
+        return wrapping(BinaryOp::Mul, Half, Odd);
+      };
+
+      llvm::SmallVector<AST *> Closed;
+      for (const Update &U : Loop.Updates)
+      {
+        // the counter in the first iteration, as this statement sees it
+        Expr *First = Cloner.clone(Loop.Start);
+        if (U.AfterStep)
+          First = wrapping(BinaryOp::Plus, First, makeNumber(Loop.Step));
+        Expr *Value = nullptr;
+        if (U.Store)
+        {
+          // the value of the last iteration
+          Expr *Last = Inv(U);
+          if (U.Coef)
+          {
+            Expr *Counter = wrapping(BinaryOp::Plus, First,
+                                     wrapping(BinaryOp::Mul, wrapping(BinaryOp::Minus, Cloner.clone(Trips), makeNumber(1)),
+                                              makeNumber(Loop.Step)));
+            Expr *Scaled = wrapping(BinaryOp::Mul, makeNumber((int)U.Coef), Counter);
+            Last = Last ? wrapping(BinaryOp::Plus, Last, Scaled) : Scaled;
+          }
+          Value = Last ? Last : makeNumber(0);
+        }
+        else
+        {
+          // trips * Inv + Coef * (trips * First + Step * HalfSquare)
+          Expr *Sum = nullptr;
+          if (Expr *Each = Inv(U))
+            Sum = wrapping(BinaryOp::Mul, Cloner.clone(Trips), Each);
+          if (U.Coef)
+          {
+            Expr *Counters = wrapping(BinaryOp::Plus, wrapping(BinaryOp::Mul, Cloner.clone(Trips), First),
+                                      wrapping(BinaryOp::Mul, makeNumber(Loop.Step), HalfSquare()));
+            Expr *Scaled = wrapping(BinaryOp::Mul, makeNumber((int)U.Coef), Counters);
+            Sum = Sum ? wrapping(BinaryOp::Plus, Sum, Scaled) : Scaled;
+          }
+          if (!Sum)
+            continue;
+          Value = wrapping(U.Subtract ? BinaryOp::Minus : BinaryOp::Plus, new Final(Final::Ident, U.Var), Sum);
+        }
+        Closed.push_back(new Assignment(new Final(Final::Ident, U.Var), Value, Assignment::Assign, nullptr));
+      }
+      Expr *End = wrapping(BinaryOp::Plus, Cloner.clone(Loop.Start),
+                           wrapping(BinaryOp::Mul, Cloner.clone(Trips), makeNumber(Loop.Step)));
+      Closed.push_back(new Assignment(new Final(Final::Ident, Loop.Counter), End, Assignment::Assign, nullptr));
+
+      ++Replaced;
+      if (Known)
+      {
+        Out.append(Closed.begin(), Closed.end());
+        return;
+      }
+      Logic *Enter = Cloner.clone(Cond);
+      if (Safe)
+      {
+        Out.push_back(new IfStmt(Enter, Closed, {}, {}));
+        return;
+      }
+      // the loop itself runs if the distance does not fit in an int, which
+      // is exactly Lo < 0 and Hi > 2^31 - 1 + Lo
+      ++Guarded;
+      Logic *Fits = new LogicalExpr(
+          new Comparison(Cloner.clone(Lo), makeNumber(0), Comparison::Greater_equal),
+          new Comparison(Cloner.clone(Hi), wrapping(BinaryOp::Plus, makeNumber(INT32_MAX), Cloner.clone(Lo)),
+                         Comparison::Less_equal),
+          LogicalExpr::Or);
+      Out.push_back(new IfStmt(new LogicalExpr(Enter, Fits, LogicalExpr::And), Closed, {&Node}, {}));
+    }
+
+    Expr *Inv(const Update &U)
+    {
+      return U.Inv ? Cloner.clone(U.Inv) : nullptr;
+    }
+
+  public:
+    ClosedFormVisitor(unsigned &Replaced, unsigned &Guarded) : Replaced(Replaced), Guarded(Guarded) {}
+
+    virtual void visit(ForStmt &Node) override
+    {
+      Node.setBody(rewrite(Node.begin(), Node.end()));
+      CountingLoop Loop;
+      Assignment *Init = Node.getFirst();
+      Loop.Counter = Init->getLeft()->getVal();
+      llvm::SmallVector<AST *> Body(Node.begin(), Node.end());
+      AST *Step = Node.getThirdAssign() ? (AST *)Node.getThirdAssign() : (AST *)Node.getThirdUnary();
+      Body.push_back(Step);
+      llvm::StringSet<> Assigned;
+      AssignedVars Collector(Assigned);
+      for (AST *Stmt : Body)
+        Stmt->accept(Collector);
+      // the step is the last statement of the body, so only it may step i
+      if (!Init->getRightExpr() || !invariant(Init->getRightExpr(), Loop.Counter, Assigned) ||
+          !countingLoop(Node.getSecond(), Body, Loop) || !stepOf(Step, Loop.Counter))
+      {
+        Out.push_back(&Node);
+        return;
+      }
+      Loop.Start = Init->getRightExpr();
+      Out.push_back(Init);
+      replace(Node, Node.getSecond(), Loop);
+    };
+
+    virtual void visit(WhileStmt &Node) override
+    {
+      Node.setBody(rewrite(Node.begin(), Node.end()));
+      CountingLoop Loop;
+      llvm::SmallVector<AST *> Body(Node.begin(), Node.end());
+      if (!countingLoop(Node.getCond(), Body, Loop))
+      {
+        Out.push_back(&Node);
+        return;
+      }
+      // the counter starts with the value it has before the loop
+      Loop.Start = new Final(Final::Ident, Loop.Counter);
+      replace(Node, Node.getCond(), Loop);
+    };
+  };
+}
+
+void ClosedFormLoops::optimize(Program *Tree)
+{
+  if (!Tree)
+    return;
+  Replaced = Guarded = 0;
+  iv::ClosedFormVisitor Replacer(Replaced, Guarded);
+  Tree->accept(Replacer);
+  // folds the closed forms of loops with literal bounds
+  if (Replaced)
+  {
+    ConstProp Folder;
+    Folder.optimize(Tree);
+  }
+}
+
+void ClosedFormLoops::report(llvm::raw_ostream &OS)
+{
+  if (Replaced)
+    OS << llvm::format("  closed-form loops  %8u (%u guarded)\n", Replaced, Guarded);
+}
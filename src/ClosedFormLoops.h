@@ -0,0 +1,34 @@
+#ifndef CLOSEDFORMLOOPS_H
+#define CLOSEDFORMLOOPS_H
+
+#include "AST.h"
+#include "ASTPass.h"
+
+// Replacement of counting loops by the closed form of their effect.
+// A for or while loop whose counter i steps by a literal towards a bound
+// that does not change in the loop runs T times, with T computed from the
+// bound and the start of i. If every other statement of its body adds an
+// affine function of i to a variable (s += k, s = s - 2 * i, count++) or
+// stores one (x = i + 1), the loop is replaced by
+//   if (cond) { s = s + T * k + ...; x = ...; i = start + T * step; }
+// using wrapping + - *, so the result is the one of the loop modulo 2^32.
+// When the bound and the start are not known to be at most 2^31 - 1 apart
+// the closed form is guarded by a test and the loop kept for the other case.
+// Constant propagation runs again over the program if a loop was replaced.
+class ClosedFormLoops : public ASTPass
+{
+  unsigned Replaced = 0;            // loops replaced by their closed form
+  unsigned Guarded = 0;             // of those, kept for a large distance
+
+public:
+  void optimize(Program *Tree);
+
+  virtual void visit(Program &Node) override
+  {
+    optimize(&Node);
+  };
+
+  virtual void report(llvm::raw_ostream &OS) override;
+};
+
+#endif
@@ -1,6 +1,13 @@
 #include "CodeGen.h"
+#include "AssignedVars.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/ADT/SmallVector.h"
@@ -11,6 +18,216 @@ using namespace llvm;
 // Define a visitor class for generating LLVM IR from the AST.
 namespace
 ns{
+  // Cheaper instructions CodeGen emits for an operator with a constant
+  // operand, for a small if/else or for an if/elif chain of equality tests
+  enum LoweringKind
+  {
+    MulShift,
+    DivShift,
+    ModMask,
+    PowMultiply,
+    IfSelect,
+    IfSwitch,
+    NumLowerings
+  };
+
+  struct Lowering
+  {
+    const char *Name;
+    const char *Pattern;
+  };
+
+  const Lowering Lowerings[NumLowerings] = {
+    {"mul-shift", "x * 2^k -> x << k"},
+    {"div-shift", "x / 2^k -> shifts"},
+    {"mod-mask", "x % 2^k -> mask"},
+    {"pow-multiply", "x ^ c -> multiplies"},
+    {"if-select", "if/else -> selects"},
+    {"if-switch", "== chain -> switch"},
+  };
+
+  // Whether an arm statement, expression or condition can be computed when
+  // its if arm is not taken: no ++ or --, no division that may trap and
+  // no ^ that needs a loop. Cost counts the operations it takes; loads of
+  // variables are not counted, since they become registers.
+  class Speculation : public ASTVisitor
+  {
+    bool Literal = false;           // the last visited node is a number
+    int LiteralValue = 0;
+
+    // x / c, x % c and x ^ c with c a literal other than 0 and -1
+    void constantRight(Expr *Right)
+    {
+      Right->accept(*this);
+      Safe = Safe && Literal && LiteralValue != 0 && LiteralValue != -1;
+    }
+
+  public:
+    bool Safe = true;
+    unsigned Cost = 0;
+    Assignment *Assign = nullptr;   // the statement, if it is an assignment
+    llvm::StringSet<> Reads;
+
+    virtual void visit(Final &Node) override
+    {
+      Literal = Node.getKind() != Final::Ident;
+      if (Literal && Node.getVal().getAsInteger(10, LiteralValue))
+        LiteralValue = 0;
+      else if (!Literal)
+        Reads.insert(Node.getVal());
+    };
+
+    virtual void visit(SignedNumber &Node) override
+    {
+      Literal = true;
+      if (Node.getValue().getAsInteger(10, LiteralValue))
+        LiteralValue = 0;
+      else if (Node.getSign() == SignedNumber::Minus)
+        LiteralValue = -LiteralValue;
+    };
+
+    virtual void visit(BinaryOp &Node) override
+    {
+      Node.getLeft()->accept(*this);
+      switch (Node.getOperator())
+      {
+      case BinaryOp::Div:
+      case BinaryOp::Mod:
+      case BinaryOp::Exp:
+        constantRight(Node.getRight());
+        break;
+      default:
+        Node.getRight()->accept(*this);
+        break;
+      }
+      ++Cost;
+      Literal = false;
+    };
+
+    virtual void visit(UnaryOp &Node) override
+    {
+      Safe = false;
+    };
+
+    virtual void visit(NegExpr &Node) override
+    {
+      Node.getExpr()->accept(*this);
+      ++Cost;
+      Literal = false;
+    };
+
+    virtual void visit(Assignment &Node) override
+    {
+      Assign = &Node;
+      if (Node.getRightExpr())
+      {
+        if (Node.getAssignKind() == Assignment::Slash_assign)
+          constantRight(Node.getRightExpr());
+        else
+          Node.getRightExpr()->accept(*this);
+      }
+      else
+        Node.getRightLogic()->accept(*this);
+      if (Node.getAssignKind() != Assignment::Assign)
+      {
+        Node.getLeft()->accept(*this);
+        ++Cost;
+      }
+    };
+
+    virtual void visit(Comparison &Node) override
+    {
+      if (Node.getLeft())
+        Node.getLeft()->accept(*this);
+      if (Node.getRight())
+      {
+        Node.getRight()->accept(*this);
+        ++Cost;
+      }
+      Literal = false;
+    };
+
+    virtual void visit(LogicalExpr &Node) override
+    {
+      Node.getLeft()->accept(*this);
+      if (Node.getRight())
+      {
+        Node.getRight()->accept(*this);
+        ++Cost;
+      }
+      Literal = false;
+    };
+
+    virtual void visit(DeclarationInt &Node) override { Safe = false; };
+    virtual void visit(DeclarationBool &Node) override { Safe = false; };
+    virtual void visit(IfStmt &Node) override { Safe = false; };
+    virtual void visit(elifStmt &Node) override { Safe = false; };
+    virtual void visit(WhileStmt &Node) override { Safe = false; };
+    virtual void visit(ForStmt &Node) override { Safe = false; };
+    virtual void visit(PrintStmt &Node) override { Safe = false; };
+  };
+
+  // Whether a condition is x == c or c == x with x a variable and c a literal
+  class CaseTest : public ASTVisitor
+  {
+    Final *Ident = nullptr;         // the last visited node, if it is a variable
+    bool Literal = false;           // the last visited node is a number
+
+  public:
+    Final *Var = nullptr;           // x
+    Expr *Case = nullptr;           // c
+
+    CaseTest(Logic *Cond)
+    {
+      Cond->accept(*this);
+    }
+
+    virtual void visit(Final &Node) override
+    {
+      Ident = Node.getKind() == Final::Ident ? &Node : nullptr;
+      Literal = !Ident;
+    };
+
+    virtual void visit(SignedNumber &Node) override
+    {
+      Ident = nullptr;
+      Literal = true;
+    };
+
+    virtual void visit(Comparison &Node) override
+    {
+      if (Node.getOperator() != Comparison::Equal || !Node.getLeft() || !Node.getRight())
+        return;
+      Node.getLeft()->accept(*this);
+      Final *LeftIdent = Ident;
+      bool LeftLiteral = Literal;
+      Node.getRight()->accept(*this);
+      if (LeftIdent && Literal)
+      {
+        Var = LeftIdent;
+        Case = Node.getRight();
+      }
+      else if (LeftLiteral && Ident)
+      {
+        Var = Ident;
+        Case = Node.getLeft();
+      }
+    };
+
+    virtual void visit(BinaryOp &Node) override { Ident = nullptr; Literal = false; };
+    virtual void visit(NegExpr &Node) override { Ident = nullptr; Literal = false; };
+    virtual void visit(UnaryOp &Node) override {};
+    virtual void visit(LogicalExpr &Node) override {};
+    virtual void visit(Assignment &Node) override {};
+    virtual void visit(DeclarationInt &Node) override {};
+    virtual void visit(DeclarationBool &Node) override {};
+    virtual void visit(IfStmt &Node) override {};
+    virtual void visit(elifStmt &Node) override {};
+    virtual void visit(WhileStmt &Node) override {};
+    virtual void visit(ForStmt &Node) override {};
+    virtual void visit(PrintStmt &Node) override {};
+  };
+
   class ToIRVisitor : public ASTVisitor
   {
     Module *M;
@@ -26,6 +243,8 @@ ns{
     Constant *Int1True;
 
     Value *V;
+    unsigned SelectLimit;                // instructions an if/else may compute to become selects
+    unsigned Lowered[NumLowerings] = {}; // times each lowering was used
     StringMap<AllocaInst *> nameMapInt;
     StringMap<AllocaInst *> nameMapBool;
 
@@ -35,9 +254,83 @@ ns{
     FunctionType *PrintBoolFnTy;
     Function *PrintBoolFn;
 
+    // Values of expressions that were computed already and are still valid.
+    // The cse pass shares equal expressions, so a node met again is looked up
+    // here instead of being computed again. An entry is dropped when a variable
+    // it reads is stored, and when the code leaves the block that computed it.
+    struct ComputedValue
+    {
+      Value *Val;
+      llvm::SmallVector<StringRef, 4> Reads;
+    };
+    DenseMap<Expr *, ComputedValue> Available;
+    StringMap<llvm::SmallVector<Expr *, 4>> Readers; // entries that read a variable
+    llvm::SmallVector<Expr *> Computed;              // entries in the order they were added
+
+    bool reuse(Expr *Node)
+    {
+      DenseMap<Expr *, ComputedValue>::const_iterator It = Available.find(Node);
+      if (It == Available.end())
+        return false;
+      V = It->second.Val;
+      return true;
+    }
+
+    // Adds the variables an operand reads to Reads, returns false if its value can not be reused
+    bool operandReads(Expr *Operand, Value *Val, llvm::SmallVectorImpl<StringRef> &Reads)
+    {
+      if (isa<Constant>(Val))
+        return true;
+      DenseMap<Expr *, ComputedValue>::const_iterator It = Available.find(Operand);
+      if (It == Available.end() || It->second.Val != Val)
+        return false;
+      for (StringRef Var : It->second.Reads)
+        if (std::find(Reads.begin(), Reads.end(), Var) == Reads.end())
+          Reads.push_back(Var);
+      return true;
+    }
+
+    void remember(Expr *Node, Value *Val, llvm::ArrayRef<StringRef> Reads)
+    {
+      ComputedValue &Entry = Available[Node];
+      Entry.Val = Val;
+      Entry.Reads.assign(Reads.begin(), Reads.end());
+      for (StringRef Var : Reads)
+        Readers[Var].push_back(Node);
+      Computed.push_back(Node);
+    }
+
+    // Drops the values that read a variable which is stored
+    void kill(StringRef Var)
+    {
+      StringMap<llvm::SmallVector<Expr *, 4>>::iterator It = Readers.find(Var);
+      if (It == Readers.end())
+        return;
+      for (Expr *E : It->second)
+        Available.erase(E);
+      It->second.clear();
+    }
+
+    void killAssigned(AST *Node)
+    {
+      llvm::StringSet<> Vars;
+      AssignedVars Collector(Vars);
+      Node->accept(Collector);
+      for (llvm::StringSet<>::const_iterator I = Vars.begin(), E = Vars.end(); I != E; ++I)
+        kill(I->getKey());
+    }
+
+    // Drops the values computed since Mark, when their block does not dominate what follows
+    void forgetSince(size_t Mark)
+    {
+      for (size_t I = Mark, E = Computed.size(); I != E; ++I)
+        Available.erase(Computed[I]);
+      Computed.resize(Mark);
+    }
+
   public:
     // Constructor for the visitor class.
-    ToIRVisitor(Module *M) : M(M), Builder(M->getContext())
+    ToIRVisitor(Module *M, unsigned SelectLimit = 0) : M(M), Builder(M->getContext()), SelectLimit(SelectLimit)
     {
       // Initialize LLVM types and constants.
       VoidTy = Type::getVoidTy(M->getContext());
@@ -79,6 +372,25 @@ ns{
       Builder.CreateRet(Int32Zero);
     }
 
+    // Entry point for a program that was evaluated at compile time
+    void run(ArrayRef<PrintedValue> Prints)
+    {
+      FunctionType *MainFty = FunctionType::get(Int32Ty, {Int32Ty, Int8PtrPtrTy}, false);
+      Function *MainFn = Function::Create(MainFty, GlobalValue::ExternalLinkage, "main", M);
+      BasicBlock *BB = BasicBlock::Create(M->getContext(), "entry", MainFn);
+      Builder.SetInsertPoint(BB);
+
+      for (const PrintedValue &P : Prints)
+      {
+        if (P.IsBool)
+          Builder.CreateCall(PrintBoolFnTy, PrintBoolFn, {P.Value ? Int1True : Int1False});
+        else
+          Builder.CreateCall(PrintIntFnTy, PrintIntFn, {ConstantInt::get(Int32Ty, P.Value, true)});
+      }
+
+      Builder.CreateRet(Int32Zero);
+    }
+
     // Visit function for the Program node in the AST.
     virtual void visit(Program &Node) override
     {
@@ -125,6 +437,7 @@ ns{
         {
           Builder.CreateStore(Int32Zero, nameMapInt[Var]);
         }
+        kill(Var);
         itVal++;
       }
     };
@@ -165,16 +478,20 @@ ns{
         {
           Builder.CreateStore(Int1False, nameMapBool[Var]);
         }
+        kill(Var);
         itVal++;
       }
     };
-    // TODO
-    virtual void visit(Assignment &Node) override
+    // The value an assignment stores
+    Value *assignedValue(Assignment &Node)
     {
-      // Get the name of the variable being assigned.
-      llvm::StringRef varName = Node.getLeft()->getVal();
-      Node.getLeft()->accept(*this);
-      Value *varVal = V;
+      // Only the compound assignments read the old value.
+      Value *varVal = nullptr;
+      if (Node.getAssignKind() != Assignment::Assign)
+      {
+        Node.getLeft()->accept(*this);
+        varVal = V;
+      }
 
       if (Node.getRightExpr() == nullptr)
         Node.getRightLogic()->accept(*this);        
@@ -186,38 +503,51 @@ ns{
       switch (Node.getAssignKind())
       {
       case Assignment::Plus_assign:
-        val = Builder.CreateNSWAdd(varVal, val);
+        val = createBinary(BinaryOp::Plus, varVal, val);
         break;
       case Assignment::Minus_assign:
-        val = Builder.CreateNSWSub(varVal, val);
+        val = createBinary(BinaryOp::Minus, varVal, val);
         break;
       case Assignment::Star_assign:
-        val = Builder.CreateNSWMul(varVal, val);
+        val = createBinary(BinaryOp::Mul, varVal, val);
         break;
       case Assignment::Slash_assign:
-        val = Builder.CreateSDiv(varVal, val);
+        val = createBinary(BinaryOp::Div, varVal, val);
         break;
       default:
         break;
       }
+      return val;
+    }
 
-      // Create a store instruction to assign the value to the variable.
-      if (isBool(((Final*)Node.getLeft())->getVal()))
+    // Create a store instruction to assign the value to the variable.
+    void store(StringRef varName, Value *val)
+    {
+      if (isBool(varName))
         Builder.CreateStore(val, nameMapBool[varName]);
       else
         Builder.CreateStore(val, nameMapInt[varName]);
+      kill(varName);
+    }
 
+    // TODO
+    virtual void visit(Assignment &Node) override
+    {
+      store(Node.getLeft()->getVal(), assignedValue(Node));
     };
 
     virtual void visit(Final &Node) override
     {
       if (Node.getKind() == Final::Ident)
       {
+        if (reuse(&Node))
+          return;
         // If the Final is an identifier, load its value from memory.
         if (isBool(Node.getVal()))
           V = Builder.CreateLoad(Int1Ty, nameMapBool[Node.getVal()]);
         else
           V = Builder.CreateLoad(Int32Ty, nameMapInt[Node.getVal()]);
+        remember(&Node, V, Node.getVal());
       }
       else
       {
@@ -230,39 +560,108 @@ ns{
 
     virtual void visit(BinaryOp &Node) override
     {
+      if (reuse(&Node))
+        return;
+      llvm::SmallVector<StringRef, 4> Reads;
+
       // Visit the left-hand side of the binary operation and get its value.
       Node.getLeft()->accept(*this);
       Value *Left = V;
+      bool Reusable = operandReads(Node.getLeft(), Left, Reads);
 
       // Visit the right-hand side of the binary operation and get its value.
       Node.getRight()->accept(*this);
       Value *Right = V;
+      Reusable = Reusable && operandReads(Node.getRight(), Right, Reads);
 
-      // Perform the binary operation based on the operator type and create the corresponding instruction.
-      switch (Node.getOperator())
+      V = createBinary(Node.getOperator(), Left, Right, Node.wraps());
+      if (Reusable && !isa<Constant>(V))
+        remember(&Node, V, Reads);
+    };
+
+    // Perform the binary operation based on the operator type and create the corresponding instruction.
+    // Wraps drops the no signed wrap flags of + - and *.
+    Value *createBinary(BinaryOp::Operator Op, Value *Left, Value *Right, bool Wraps = false)
+    {
+      if (Op == BinaryOp::Mul && isa<ConstantInt>(Left))
+        std::swap(Left, Right);
+      if (Value *Reduced = lowerConstant(Op, Left, Right, Wraps))
+        return Reduced;
+      switch (Op)
       {
       case BinaryOp::Plus:
-        V = Builder.CreateNSWAdd(Left, Right);
-        break;
+        return Builder.CreateAdd(Left, Right, "", false, !Wraps);
       case BinaryOp::Minus:
-        V = Builder.CreateNSWSub(Left, Right);
-        break;
+        return Builder.CreateSub(Left, Right, "", false, !Wraps);
       case BinaryOp::Mul:
-        V = Builder.CreateNSWMul(Left, Right);
-        break;
+        return Builder.CreateMul(Left, Right, "", false, !Wraps);
       case BinaryOp::Div:
-        V = Builder.CreateSDiv(Left, Right);
-        break;
+        return Builder.CreateSDiv(Left, Right);
       case BinaryOp::Mod:
-        V = Builder.CreateSRem(Left, Right);
-        break;
-      case BinaryOp::Exp:
-        V = CreateExp(Left, Right);
-        break;
+        return Builder.CreateSRem(Left, Right);
       default:
-        break;
+        return CreateExp(Left, Right);
       }
-    };
+    }
+
+    // Strength reduction when the right operand is a constant, nullptr if there is none.
+    // Every form gives exactly the value of the instruction it replaces.
+    Value *lowerConstant(BinaryOp::Operator Op, Value *Left, Value *Right, bool Wraps)
+    {
+      ConstantInt *C = dyn_cast<ConstantInt>(Right);
+      if (!C || isa<Constant>(Left))
+        return nullptr;
+      int64_t N = C->getSExtValue();
+      if (Op == BinaryOp::Exp)
+      {
+        // the loop of CreateExp multiplies without overflow flags, so squaring gives the same value
+        ++Lowered[PowMultiply];
+        Value *Result = nullptr;
+        for (Value *Base = Left; N > 0; N >>= 1)
+        {
+          if (N & 1)
+            Result = Result ? Builder.CreateMul(Result, Base) : Base;
+          if (N > 1)
+            Base = Builder.CreateMul(Base, Base);
+        }
+        return Result ? Result : Int32One;
+      }
+      if (N < 2 || !isPowerOf2_64(N))
+        return nullptr;
+      unsigned K = Log2_64(N);
+      switch (Op)
+      {
+      case BinaryOp::Mul:
+        // shl nsw is poison exactly when mul nsw overflows
+        ++Lowered[MulShift];
+        return Builder.CreateShl(Left, K, "", false, !Wraps);
+      case BinaryOp::Div:
+      {
+        // sdiv rounds toward zero: negative values get 2^k - 1 added before the shift
+        ++Lowered[DivShift];
+        Value *Bias = Builder.CreateLShr(Builder.CreateAShr(Left, 31), 32 - K);
+        return Builder.CreateAShr(Builder.CreateAdd(Left, Bias), K);
+      }
+      case BinaryOp::Mod:
+      {
+        // srem has the sign of the dividend: x - ((x + bias) & -2^k) with the bias of the division
+        ++Lowered[ModMask];
+        Value *Bias = Builder.CreateLShr(Builder.CreateAShr(Left, 31), 32 - K);
+        Value *Rounded = Builder.CreateAnd(Builder.CreateAdd(Left, Bias), ConstantInt::get(Int32Ty, -N, true));
+        return Builder.CreateSub(Left, Rounded);
+      }
+      default:
+        return nullptr;
+      }
+    }
+
+    void report(raw_ostream &OS)
+    {
+      OS << "codegen lowerings\n";
+      for (unsigned I = 0; I != NumLowerings; ++I)
+        if (Lowered[I])
+          OS << llvm::format("  %-14s %-20s %8u\n", Lowerings[I].Name, Lowerings[I].Pattern, Lowered[I]);
+    }
 
     Value* CreateExp(Value *Left, Value *Right)
     {
@@ -316,6 +715,7 @@ ns{
       }
       
       Builder.CreateStore(V, nameMapInt[Node.getIdent()]);
+      kill(Node.getIdent());
     };
 
     virtual void visit(SignedNumber &Node) override
@@ -327,8 +727,14 @@ ns{
 
     virtual void visit(NegExpr &Node) override
     {
+      if (reuse(&Node))
+        return;
+      llvm::SmallVector<StringRef, 4> Reads;
       Node.getExpr()->accept(*this);
+      bool Reusable = operandReads(Node.getExpr(), V, Reads);
       V = Builder.CreateNeg(V);
+      if (Reusable && !isa<Constant>(V))
+        remember(&Node, V, Reads);
     };
 
     virtual void visit(LogicalExpr &Node) override{
@@ -434,62 +840,199 @@ ns{
       }      
     };
 
-    virtual void visit(WhileStmt &Node) override
+    // Emits a loop in rotated form: its condition is tested once before the
+    // loop, and again at the end of every iteration by a latch that branches
+    // back to the body, so an iteration takes one branch instead of two
+    void rotatedLoop(AST *Loop, Logic *Cond, llvm::ArrayRef<AST *> Body, AST *Step, StringRef Name)
     {
-      llvm::BasicBlock* WhileCondBB = llvm::BasicBlock::Create(M->getContext(), "while.cond", Builder.GetInsertBlock()->getParent());
-      llvm::BasicBlock* WhileBodyBB = llvm::BasicBlock::Create(M->getContext(), "while.body", Builder.GetInsertBlock()->getParent());
-      llvm::BasicBlock* AfterWhileBB = llvm::BasicBlock::Create(M->getContext(), "after.while", Builder.GetInsertBlock()->getParent());
-
-      Builder.CreateBr(WhileCondBB); //?
-      Builder.SetInsertPoint(WhileCondBB);
-      Node.getCond()->accept(*this);
-      Value* val=V;
-      Builder.CreateCondBr(val, WhileBodyBB, AfterWhileBB);
-      Builder.SetInsertPoint(WhileBodyBB);
-
-      for (llvm::SmallVector<AST* >::const_iterator I = Node.begin(), E = Node.end(); I != E; ++I)
-        {
-            (*I)->accept(*this);
-        }
-
-      Builder.CreateBr(WhileCondBB);
+      Function *Fn = Builder.GetInsertBlock()->getParent();
+      llvm::BasicBlock* BodyBB = llvm::BasicBlock::Create(M->getContext(), Name + ".body", Fn);
+      // placed after the blocks of the body, which the latch falls through to
+      llvm::BasicBlock* AfterBB = llvm::BasicBlock::Create(M->getContext(), "after." + Name);
+
+      // the guard runs before the loop, so it may use the values computed before it
+      Cond->accept(*this);
+      Builder.CreateCondBr(V, BodyBB, AfterBB);
+      // the body is reached again from the latch
+      killAssigned(Loop);
+      size_t Mark = Computed.size();
+
+      Builder.SetInsertPoint(BodyBB);
+      for (AST *Stmt : Body)
+        Stmt->accept(*this);
+      if (Step)
+        Step->accept(*this);
+      Cond->accept(*this);
+      BranchInst *Latch = Builder.CreateCondBr(V, BodyBB, AfterBB);
+      // a loop id of its own, which later passes attach their hints to
+      TempMDTuple Temp = MDNode::getTemporary(M->getContext(), None);
+      MDNode *LoopID = MDNode::getDistinct(M->getContext(), {Temp.get()});
+      LoopID->replaceOperandWith(0, LoopID);
+      Latch->setMetadata(LLVMContext::MD_loop, LoopID);
+      forgetSince(Mark);
+
+      AfterBB->insertInto(Fn);
+      Builder.SetInsertPoint(AfterBB);
+    }
 
-      Builder.SetInsertPoint(AfterWhileBB);
-        
+    virtual void visit(WhileStmt &Node) override
+    {
+      llvm::SmallVector<AST *> Body(Node.begin(), Node.end());
+      rotatedLoop(&Node, Node.getCond(), Body, nullptr, "while");
     };
 
     virtual void visit(ForStmt &Node) override
     {
-      llvm::BasicBlock* ForCondBB = llvm::BasicBlock::Create(M->getContext(), "for.cond", Builder.GetInsertBlock()->getParent());
-      llvm::BasicBlock* ForBodyBB = llvm::BasicBlock::Create(M->getContext(), "for.body", Builder.GetInsertBlock()->getParent());
-      llvm::BasicBlock* AfterForBB = llvm::BasicBlock::Create(M->getContext(), "after.for", Builder.GetInsertBlock()->getParent());
-
       Node.getFirst()->accept(*this);
+      llvm::SmallVector<AST *> Body(Node.begin(), Node.end());
+      AST *Step = Node.getThirdAssign() ? (AST *)Node.getThirdAssign() : (AST *)Node.getThirdUnary();
+      rotatedLoop(&Node, Node.getSecond(), Body, Step, "for");
+    };
 
-      Builder.CreateBr(ForCondBB); //?
-
-      Builder.SetInsertPoint(ForCondBB);
-      Node.getSecond()->accept(*this);
-      Value* val=V;
-      Builder.CreateCondBr(val, ForBodyBB, AfterForBB);
+    // The assignments of an if arm, false unless it only assigns values that
+    // can be computed when it is not taken, each variable once and none from
+    // a variable the arm assigned before
+    template <typename Iterator>
+    bool selectArm(Iterator Begin, Iterator End, llvm::SmallVectorImpl<Assignment *> &Assigns, unsigned &Cost)
+    {
+      llvm::StringSet<> Assigned;
+      for (Iterator I = Begin; I != End; ++I)
+      {
+        Speculation S;
+        (*I)->accept(S);
+        if (!S.Safe || !S.Assign)
+          return false;
+        StringRef Var = S.Assign->getLeft()->getVal();
+        for (llvm::StringSet<>::const_iterator R = S.Reads.begin(), E = S.Reads.end(); R != E; ++R)
+          if (Assigned.count(R->getKey()))
+            return false;
+        if (!Assigned.insert(Var).second)
+          return false;
+        Assigns.push_back(S.Assign);
+        Cost += S.Cost;
+      }
+      return true;
+    }
 
-      Builder.SetInsertPoint(ForBodyBB);
-      for (llvm::SmallVector<AST* >::const_iterator I = Node.begin(), E = Node.end(); I != E; ++I)
-        {
-            (*I)->accept(*this);
-        }
+    // The value a variable has after an arm
+    Value *armValue(llvm::ArrayRef<Assignment *> Assigns, StringRef Var)
+    {
+      for (Assignment *A : Assigns)
+        if (A->getLeft()->getVal() == Var)
+          return assignedValue(*A);
+      if (isBool(Var))
+        return Builder.CreateLoad(Int1Ty, nameMapBool[Var]);
+      return Builder.CreateLoad(Int32Ty, nameMapInt[Var]);
+    }
 
-      if (Node.getThirdAssign() == nullptr)
-        Node.getThirdUnary()->accept(*this);
-      else
-        Node.getThirdAssign()->accept(*this);
+    // Lowers an if/else whose arms only assign to selects, if computing both
+    // arms takes at most SelectLimit instructions
+    bool selectIf(IfStmt &Node)
+    {
+      if (!SelectLimit || Node.beginElif() != Node.endElif())
+        return false;
+      llvm::SmallVector<Assignment *, 4> Then, Else;
+      unsigned Cost = 0;
+      if (!selectArm(Node.begin(), Node.end(), Then, Cost) || !selectArm(Node.beginElse(), Node.endElse(), Else, Cost))
+        return false;
+      llvm::SmallVector<StringRef, 4> Vars;
+      for (Assignment *A : llvm::concat<Assignment *>(Then, Else))
+        if (std::find(Vars.begin(), Vars.end(), A->getLeft()->getVal()) == Vars.end())
+          Vars.push_back(A->getLeft()->getVal());
+      if (Cost + Vars.size() > SelectLimit)
+        return false;
+
+      ++Lowered[IfSelect];
+      Node.getCond()->accept(*this);
+      Value *Cond = V;
+      // every value is computed before any is stored, as the other arm reads the old ones
+      llvm::SmallVector<Value *, 4> Values;
+      for (StringRef Var : Vars)
+      {
+        Value *IfTrue = armValue(Then, Var);
+        Value *IfFalse = armValue(Else, Var);
+        Values.push_back(Builder.CreateSelect(Cond, IfTrue, IfFalse));
+      }
+      for (unsigned I = 0; I != Vars.size(); ++I)
+        store(Vars[I], Values[I]);
+      return true;
+    }
 
-      Builder.CreateBr(ForCondBB);
+    // Lowers an if/elif chain whose conditions all compare the same int
+    // variable with distinct literals to a switch, which LLVM turns into a
+    // jump table or a binary search instead of a compare per arm
+    bool switchIf(IfStmt &Node)
+    {
+      if (Node.beginElif() == Node.endElif())
+        return false;
+      CaseTest First(Node.getCond());
+      if (!First.Var || isBool(First.Var->getVal()))
+        return false;
+      llvm::SmallVector<Expr *, 8> Literals = {First.Case};
+      for (llvm::SmallVector<elifStmt *, 8>::const_iterator I = Node.beginElif(), E = Node.endElif(); I != E; ++I)
+      {
+        CaseTest Test((*I)->getCond());
+        if (!Test.Var || Test.Var->getVal() != First.Var->getVal())
+          return false;
+        Literals.push_back(Test.Case);
+      }
+      // literals are constants, visiting them emits nothing
+      llvm::SmallVector<ConstantInt *, 8> Cases;
+      llvm::SmallPtrSet<ConstantInt *, 8> Distinct;
+      for (Expr *Literal : Literals)
+      {
+        Literal->accept(*this);
+        ConstantInt *Case = dyn_cast<ConstantInt>(V);
+        if (!Case || !Distinct.insert(Case).second)
+          return false;
+        Cases.push_back(Case);
+      }
 
-      Builder.SetInsertPoint(AfterForBB);
-    };
+      ++Lowered[IfSwitch];
+      Function *Fn = Builder.GetInsertBlock()->getParent();
+      First.Var->accept(*this);
+      Value *Scrutinee = V;
+      llvm::SmallVector<llvm::BasicBlock *, 8> Bodies;
+      for (unsigned I = 0; I != Cases.size(); ++I)
+        Bodies.push_back(llvm::BasicBlock::Create(M->getContext(), "case.body", Fn));
+      llvm::BasicBlock* ElseBB = nullptr;
+      if (Node.beginElse() != Node.endElse())
+        ElseBB = llvm::BasicBlock::Create(M->getContext(), "else.body", Fn);
+      llvm::BasicBlock* AfterIfBB = llvm::BasicBlock::Create(M->getContext(), "after.if", Fn);
+      SwitchInst *Switch = Builder.CreateSwitch(Scrutinee, ElseBB ? ElseBB : AfterIfBB, Cases.size());
+      for (unsigned I = 0; I != Cases.size(); ++I)
+        Switch->addCase(Cases[I], Bodies[I]);
+
+      // values computed in an arm are only valid in that arm
+      size_t Mark = Computed.size();
+      Builder.SetInsertPoint(Bodies[0]);
+      for (llvm::SmallVector<AST* >::const_iterator I = Node.begin(), E = Node.end(); I != E; ++I)
+        (*I)->accept(*this);
+      Builder.CreateBr(AfterIfBB);
+      forgetSince(Mark);
+      unsigned Arm = 1;
+      for (llvm::SmallVector<elifStmt *, 8>::const_iterator I = Node.beginElif(), E = Node.endElif(); I != E; ++I)
+      {
+        Builder.SetInsertPoint(Bodies[Arm++]);
+        (*I)->accept(*this);
+        Builder.CreateBr(AfterIfBB);
+        forgetSince(Mark);
+      }
+      if (ElseBB)
+      {
+        Builder.SetInsertPoint(ElseBB);
+        for (llvm::SmallVector<AST* >::const_iterator I = Node.beginElse(), E = Node.endElse(); I != E; ++I)
+          (*I)->accept(*this);
+        Builder.CreateBr(AfterIfBB);
+        forgetSince(Mark);
+      }
+      Builder.SetInsertPoint(AfterIfBB);
+      return true;
+    }
 
     virtual void visit(IfStmt &Node) override{
+      if (selectIf(Node) || switchIf(Node))
+        return;
       llvm::BasicBlock* IfCondBB = llvm::BasicBlock::Create(M->getContext(), "if.cond", Builder.GetInsertBlock()->getParent());
       llvm::BasicBlock* IfBodyBB = llvm::BasicBlock::Create(M->getContext(), "if.body", Builder.GetInsertBlock()->getParent());
       llvm::BasicBlock* AfterIfBB = llvm::BasicBlock::Create(M->getContext(), "after.if", Builder.GetInsertBlock()->getParent());
@@ -500,6 +1043,8 @@ ns{
       Value* IfCondVal=V;
 
       Builder.SetInsertPoint(IfBodyBB);
+      // values computed in an arm are only valid in that arm
+      size_t Mark = Computed.size();
 
       for (llvm::SmallVector<AST* >::const_iterator I = Node.begin(), E = Node.end(); I != E; ++I)
         {
@@ -507,6 +1052,7 @@ ns{
         }
 
       Builder.CreateBr(AfterIfBB);
+      forgetSince(Mark);
 
       llvm::BasicBlock* PreviousCondBB = IfCondBB;
       llvm::BasicBlock* PreviousBodyBB = IfBodyBB;
@@ -527,6 +1073,7 @@ ns{
         Builder.SetInsertPoint(ElifBodyBB);
         (*I)->accept(*this);
         Builder.CreateBr(AfterIfBB);
+        forgetSince(Mark);
 
         PreviousCondBB = ElifCondBB;
         PreviousCondVal = ElifCondVal;
@@ -540,13 +1087,14 @@ ns{
             (*I)->accept(*this);
         }
         Builder.CreateBr(AfterIfBB);
+        forgetSince(Mark);
 
         Builder.SetInsertPoint(PreviousCondBB);
         Builder.CreateCondBr(PreviousCondVal, PreviousBodyBB, ElseBB);
       }
       else {
         Builder.SetInsertPoint(PreviousCondBB);
-        Builder.CreateCondBr(IfCondVal, PreviousBodyBB, AfterIfBB);
+        Builder.CreateCondBr(PreviousCondVal, PreviousBodyBB, AfterIfBB);
       }
 
       Builder.SetInsertPoint(AfterIfBB);
@@ -561,18 +1109,29 @@ ns{
   };
 }; // namespace
 
-void CodeGen::compile(Program *Tree)
+void CodeGen::compile(Program *Tree, bool Report, unsigned SelectLimit)
 {
   // Create an LLVM context and a module.
   LLVMContext Ctx;
   Module *M = new Module("simple-compiler", Ctx);
 
   // Create an instance of the ToIRVisitor and run it on the AST to generate LLVM IR.
-  ns::ToIRVisitor *ToIR = new ns::ToIRVisitor(M);
+  ns::ToIRVisitor *ToIR = new ns::ToIRVisitor(M, SelectLimit);
 
 
   ToIR->run(Tree);
+  if (Report)
+    ToIR->report(errs());
 
   // Print the generated module to the standard output.
   M->print(outs(), nullptr);
 }
+
+void CodeGen::compile(ArrayRef<PrintedValue> Prints)
+{
+  LLVMContext Ctx;
+  Module *M = new Module("simple-compiler", Ctx);
+  ns::ToIRVisitor *ToIR = new ns::ToIRVisitor(M);
+  ToIR->run(Prints);
+  M->print(outs(), nullptr);
+}
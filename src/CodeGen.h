@@ -2,11 +2,19 @@
 #define CODEGEN_H
 
 #include "AST.h"
+#include "Evaluator.h"
+#include "llvm/ADT/ArrayRef.h"
 
 class CodeGen
 {
 public:
- void compile(Program *Tree);
+ // With a report, how often each strength reduction was used is printed to errs().
+ // An if/else whose arms only assign values that take at most SelectLimit
+ // instructions to compute in both arms is lowered to selects (0 for never).
+ void compile(Program *Tree, bool Report = false, unsigned SelectLimit = 0);
+
+ // A main that only prints the values a program evaluated at compile time printed
+ void compile(llvm::ArrayRef<PrintedValue> Prints);
 
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "CommonSubexprElim.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace cse{
+
+  // Replaces every expression by the one node with its structure.
+  // Each shared node has a value number. Leaves are keyed by their text and
+  // operators by the operator and the numbers of their operands, so equal
+  // trees are found bottom up with one table lookup per node.
+  // Expressions with ++ or -- get no number and are never shared.
+  class HashConsVisitor : public ASTVisitor
+  {
+    llvm::StringMap<Expr *> Table;          // structure -> the shared node
+    llvm::DenseMap<Expr *, unsigned> Numbers; // value number of every shared node
+    Expr *Result;                           // shared form of the last visited expression
+
+    Expr *share(Expr *E)
+    {
+      E->accept(*this);
+      return Result;
+    }
+
+    // The node already keyed by Key, or E which becomes that node
+    Expr *intern(llvm::StringRef Key, Expr *E)
+    {
+      std::pair<llvm::StringMap<Expr *>::iterator, bool> It = Table.try_emplace(Key, E);
+      if (It.second)
+      {
+        unsigned Number = Numbers.size();
+        Numbers[E] = Number;
+      }
+      return It.first->second;
+    }
+
+    bool number(Expr *E, unsigned &Number)
+    {
+      llvm::DenseMap<Expr *, unsigned>::const_iterator It = Numbers.find(E);
+      if (It == Numbers.end())
+        return false;
+      Number = It->second;
+      return true;
+    }
+
+    template <typename Iterator>
+    void all(Iterator Begin, Iterator End)
+    {
+      for (Iterator I = Begin; I != End; ++I)
+        (*I)->accept(*this);
+    }
+
+  public:
+    virtual void visit(Program &Node) override
+    {
+      all(Node.begin(), Node.end());
+    };
+
+    virtual void visit(DeclarationInt &Node) override
+    {
+      llvm::SmallVector<Expr *> Values;
+      for (llvm::SmallVector<Expr *>::const_iterator I = Node.valBegin(), E = Node.valEnd(); I != E; ++I)
+        Values.push_back(share(*I));
+      Node.setValues(Values);
+    };
+
+    virtual void visit(DeclarationBool &Node) override
+    {
+      all(Node.valBegin(), Node.valEnd());
+    };
+
+    virtual void visit(Assignment &Node) override
+    {
+      // the left side names the stored variable, it is not read
+      if (Node.getRightExpr())
+        Node.setRightExpr(share(Node.getRightExpr()));
+      else
+        Node.getRightLogic()->accept(*this);
+    };
+
+    virtual void visit(Final &Node) override
+    {
+      llvm::SmallString<32> Key(Node.getKind() == Final::Ident ? "v" : "n");
+      Key += Node.getVal();
+      Result = intern(Key, &Node);
+    };
+
+    virtual void visit(BinaryOp &Node) override
+    {
+      Node.setLeft(share(Node.getLeft()));
+      Node.setRight(share(Node.getRight()));
+      Result = &Node;
+      unsigned Left, Right;
+      if (!number(Node.getLeft(), Left) || !number(Node.getRight(), Right))
+        return;
+      llvm::SmallString<32> Key;
+      // a wrapping operation is no replacement for one that may overflow
+      llvm::raw_svector_ostream(Key) << (Node.wraps() ? 'w' : 'b') << Node.getOperator() << ':' << Left << ',' << Right;
+      Result = intern(Key, &Node);
+    };
+
+    virtual void visit(UnaryOp &Node) override
+    {
+      Result = &Node;
+    };
+
+    virtual void visit(SignedNumber &Node) override
+    {
+      llvm::SmallString<32> Key(Node.getSign() == SignedNumber::Minus ? "s-" : "s+");
+      Key += Node.getValue();
+      Result = intern(Key, &Node);
+    };
+
+    virtual void visit(NegExpr &Node) override
+    {
+      Node.setExpr(share(Node.getExpr()));
+      Result = &Node;
+      unsigned Operand;
+      if (!number(Node.getExpr(), Operand))
+        return;
+      llvm::SmallString<32> Key;
+      llvm::raw_svector_ostream(Key) << '-' << Operand;
+      Result = intern(Key, &Node);
+    };
+
+    virtual void visit(Comparison &Node) override
+    {
+      // true, false and a lone bool variable have no expression to share
+      if (!Node.getRight())
+        return;
+      Node.setLeft(share(Node.getLeft()));
+      Node.setRight(share(Node.getRight()));
+    };
+
+    virtual void visit(LogicalExpr &Node) override
+    {
+      if (Node.getLeft())
+        Node.getLeft()->accept(*this);
+      if (Node.getRight())
+        Node.getRight()->accept(*this);
+    };
+
+    virtual void visit(IfStmt &Node) override
+    {
+      Node.getCond()->accept(*this);
+      all(Node.begin(), Node.end());
+      all(Node.beginElif(), Node.endElif());
+      all(Node.beginElse(), Node.endElse());
+    };
+
+    virtual void visit(elifStmt &Node) override
+    {
+      Node.getCond()->accept(*this);
+      all(Node.begin(), Node.end());
+    };
+
+    virtual void visit(WhileStmt &Node) override
+    {
+      Node.getCond()->accept(*this);
+      all(Node.begin(), Node.end());
+    };
+
+    virtual void visit(ForStmt &Node) override
+    {
+      Node.getFirst()->accept(*this);
+      Node.getSecond()->accept(*this);
+      if (Node.getThirdAssign())
+        Node.getThirdAssign()->accept(*this);
+      all(Node.begin(), Node.end());
+    };
+
+    virtual void visit(PrintStmt &Node) override {};
+  };
+}
+
+void CommonSubexprElim::optimize(Program *Tree)
+{
+  if (!Tree)
+    return;
+  cse::HashConsVisitor Sharer;
+  Tree->accept(Sharer);
+}
@@ -0,0 +1,25 @@
+#ifndef COMMONSUBEXPRELIM_H
+#define COMMONSUBEXPRELIM_H
+
+#include "AST.h"
+#include "ASTPass.h"
+
+// Common subexpression elimination by hash-consing.
+// Structurally equal expressions without ++ or -- become one shared node,
+// so (a + b) * (a + b) - (a + b) holds a single a + b, and so does every
+// other statement that computes a + b. CodeGen computes a shared node once
+// and reuses its value until a variable it reads is stored again.
+// The tree is a DAG afterwards, which the passes that rewrite expressions
+// in place can not take, so this pass has to be the last one.
+class CommonSubexprElim : public ASTPass
+{
+public:
+  void optimize(Program *Tree);
+
+  virtual void visit(Program &Node) override
+  {
+    optimize(&Node);
+  };
+};
+
+#endif
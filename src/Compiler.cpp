@@ -2,10 +2,15 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/InitLLVM.h"
 #include "llvm/Support/raw_ostream.h"
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include "AST.h"
+#include "ASTPrinter.h"
 #include "CodeGen.h"
+#include "Evaluator.h"
 #include "Parser.h"
+#include "PassManager.h"
 #include "Sema.h"
 #include "optimizer.h"
 
@@ -23,57 +28,77 @@ static llvm::cl::opt<std::string> FileName("f",
 	llvm::cl::value_desc("filename"),
 	llvm::cl::init(""));
 
+static llvm::cl::list<std::string> Outputs("outputs",
+	llvm::cl::desc("<Variables whose final value is observable (default: output)>"),
+	llvm::cl::value_desc("names"),
+	llvm::cl::CommaSeparated);
 
-// The main function of the program.
-int main(int argc, const char **argv)
-{
-    // Initialize the LLVM framework.
-    llvm::InitLLVM X(argc, argv);
-
-    // Parse command-line options.
-    llvm::cl::ParseCommandLineOptions(argc, argv, "Simple Compiler\n");
+// The help of -passes names the default pipeline
+static const std::string PassesHelp = [] {
+	std::string Help = "<Optimization passes to run in order (default: ";
+	llvm::ArrayRef<const char *> Default = PassManager::defaultPipeline();
+	for (size_t I = 0; I != Default.size(); ++I)
+		Help += (I ? "," : "") + std::string(Default[I]);
+	return Help + "; empty for none)>";
+}();
 
+static llvm::cl::list<std::string> Passes("passes",
+	llvm::cl::desc(PassesHelp),
+	llvm::cl::value_desc("names"),
+	llvm::cl::CommaSeparated);
 
+static llvm::cl::opt<bool> ReportPasses("report-passes",
+	llvm::cl::desc("Print the wall time and node count after every optimization pass and how often its rules fired to stderr"),
+	llvm::cl::init(false));
 
-	string contentString;
-	llvm::StringRef contentRef;
+static llvm::cl::opt<bool> PrintOptimized("print-optimized",
+	llvm::cl::desc("Print the optimized program to stderr before generating code. It compiles again unless a body was emptied under a condition that reads no variable"),
+	llvm::cl::init(false));
 
-	if (!FileName.empty()) // if filename is specified
-	{
-		std::string fileName = FileName;
+static llvm::cl::opt<uint64_t> EvalSteps("eval-steps",
+	llvm::cl::desc("Run the program at compile time for up to this many steps and compile only what it prints (0 to always generate code)"),
+	llvm::cl::init(10000000));
 
-		// Use llvm::MemoryBuffer::getFile with the fileName
-		llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> fileOrErr =
-			llvm::MemoryBuffer::getFile(fileName);
+static llvm::cl::opt<uint64_t> EvalMemory("eval-memory",
+	llvm::cl::desc("Bytes of printed values and variables the compile-time run may keep"),
+	llvm::cl::init(1 << 20));
 
-		if (auto error = fileOrErr.getError()) {
-			llvm::errs() << "Error opening file: " << error.message() << "\n";
-			return 1;
-		}
-		// Use the file content from the MemoryBuffer
-		contentString = (*fileOrErr)->getBuffer().str();
-	}
-	else // if input is given directly
-	{
-		contentString = Input;
+static llvm::cl::opt<unsigned> SelectLimit("select-limit",
+	llvm::cl::desc("Instructions an if/else whose arms only assign may compute in both arms to be lowered to selects instead of branches (0 to always branch)"),
+	llvm::cl::init(8));
 
-	}
+static llvm::cl::opt<bool> TextOptimize("text-optimize",
+	llvm::cl::desc("Fold a program without braces with the text optimizer and compile the folded text"),
+	llvm::cl::init(false));
 
-	contentRef = contentString;
+static llvm::cl::opt<bool> Incremental("incremental",
+	llvm::cl::desc("After compiling, read the names of edited versions of the program from stdin, one per line, and compile each. Implies -text-optimize, which then evaluates again only what an edit changed"),
+	llvm::cl::init(false));
 
-	Token nextToken;
+static llvm::cl::opt<bool> Stream("stream",
+	llvm::cl::desc("Fold the program in one streaming pass with bounded memory and print it instead of compiling it"),
+	llvm::cl::init(false));
 
-	Optimizer optimizer(contentRef);
 
-    std::string formattedCode = optimizer.optimize();
-    llvm::errs() << "\n---------------\n";
-    llvm::errs() << "🚀Optimized code: \n";
-    llvm::errs() << formattedCode ;
-    llvm::errs() << "\n---------------\n";
+// Reads a whole file, its buffer ends with a null character
+static std::unique_ptr<llvm::MemoryBuffer> readFile(const std::string &Name)
+{
+	llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> fileOrErr =
+		llvm::MemoryBuffer::getFile(Name);
 
+	if (auto error = fileOrErr.getError()) {
+		llvm::errs() << "Error opening file: " << error.message() << "\n";
+		return nullptr;
+	}
+	return std::move(*fileOrErr);
+}
 
+// Compiles one program and prints its module to stdout.
+// Returns: 1 if it has errors or a pass is unknown, 0 otherwise
+static int compile(llvm::StringRef Code, llvm::ArrayRef<std::string> OutputVars)
+{
     // Create a lexer object and initialize it with the input expression.
-    Lexer Lex(formattedCode);
+    Lexer Lex(Code);
 
     // Create a parser object and initialize it with the lexer.
     Parser Parser(Lex);
@@ -96,10 +121,153 @@ int main(int argc, const char **argv)
         return 1;
     }
 
+    // Unless another pipeline is given: constant propagation, the loop passes (closed
+    // forms of counting loops, fusion, unrolling), algebraic simplification and
+    // reassociation, copy propagation, removal of the statements whose values never
+    // reach a print or an output variable, then sharing of the equal subexpressions.
+    PassManager Optimizations(OutputVars);
+    std::vector<std::string> Pipeline(Passes.begin(), Passes.end());
+    if (Passes.getNumOccurrences() == 0)
+        Pipeline.assign(PassManager::defaultPipeline().begin(), PassManager::defaultPipeline().end());
+    for (const std::string &Name : Pipeline)
+    {
+        std::string Error;
+        if (Name.empty() || Optimizations.addPass(Name, Error))
+            continue;
+        llvm::errs() << Error << "\nAvailable passes:\n";
+        PassManager::printPasses(llvm::errs());
+        return 1;
+    }
+    Optimizations.run(Tree, ReportPasses);
+
+    if (PrintOptimized)
+    {
+        ASTPrinter Printer;
+        llvm::errs() << "\n---------------\n";
+        llvm::errs() << "🚀Optimized code: \n";
+        Printer.print(Tree, llvm::errs());
+        llvm::errs() << "---------------\n";
+    }
+
     // Generate code for the AST using a code generator.
     CodeGen CodeGenerator;
-    CodeGenerator.compile(Tree);
 
-    // The program executed successfully.
+    // Nothing is read at runtime, so a program that runs to its end within the
+    // budget is compiled to the values it prints.
+    if (EvalSteps)
+    {
+        Evaluator Eval(EvalSteps, EvalMemory);
+        llvm::SmallVector<PrintedValue> Prints;
+        Evaluator::Outcome Result = Eval.run(Tree, Prints);
+        if (ReportPasses)
+            Eval.report(llvm::errs());
+        if (Result == Evaluator::Finished)
+        {
+            CodeGenerator.compile(Prints);
+            return 0;
+        }
+    }
+    CodeGenerator.compile(Tree, ReportPasses, SelectLimit);
+
     return 0;
 }
+
+// The main function of the program.
+int main(int argc, const char **argv)
+{
+    // Initialize the LLVM framework.
+    llvm::InitLLVM X(argc, argv);
+
+    // Parse command-line options.
+    llvm::cl::ParseCommandLineOptions(argc, argv, "Simple Compiler\n");
+
+    // Besides the printed values, only the final values of these variables are kept.
+    std::vector<std::string> OutputVars(Outputs.begin(), Outputs.end());
+    if (OutputVars.empty())
+        OutputVars.push_back("output");
+
+    // Very large inputs are never loaded: they are read in chunks and the folded program
+    // is written as it is produced. Compiling it needs the whole program in memory.
+    if (Stream)
+    {
+        Optimizer optimizer;
+        if (!FileName.empty())
+        {
+            std::ifstream file(FileName, std::ios::binary);
+            if (!file)
+            {
+                llvm::errs() << "Error opening file: " << FileName << "\n";
+                return 1;
+            }
+            optimizer.optimizeStream(file, llvm::outs());
+        }
+        else
+        {
+            std::istringstream input(Input);
+            optimizer.optimizeStream(input, llvm::outs());
+        }
+        return 0;
+    }
+
+	// The file is lexed straight from its buffer, which ends with a null character
+	std::unique_ptr<llvm::MemoryBuffer> fileBuffer;
+	llvm::StringRef contentRef;
+
+	if (!FileName.empty()) // if filename is specified
+	{
+		fileBuffer = readFile(FileName);
+		if (!fileBuffer)
+			return 1;
+		contentRef = fileBuffer->getBuffer();
+	}
+	else // if input is given directly
+	{
+		contentRef = Input;
+
+	}
+
+    // The text optimizer only knows straight-line code. It folds the constants and drops
+    // the statements no print or output variable needs before anything is parsed.
+    // It reads the lines from the buffer, so the buffer lives as long as the optimizer.
+    std::unique_ptr<Optimizer> optimizer;
+    std::string textOptimized;
+    if ((TextOptimize || Incremental) && contentRef.find_first_of("{}") == llvm::StringRef::npos)
+    {
+        optimizer.reset(new Optimizer(contentRef));
+        textOptimized = optimizer->optimize(OutputVars);
+        contentRef = textOptimized;
+    }
+    int result = compile(contentRef, OutputVars);
+    if (!Incremental)
+        return result;
+
+    // Every line of stdin names an edited version of the program. The text optimizer keeps
+    // its results between them and evaluates again only the statements an edit changed.
+    std::string editName;
+    while (std::getline(std::cin, editName))
+    {
+        std::unique_ptr<llvm::MemoryBuffer> edit = readFile(editName);
+        if (!edit)
+        {
+            result = 1;
+            continue;
+        }
+        if (edit->getBuffer().find_first_of("{}") != llvm::StringRef::npos)
+        {
+            // the next straight-line version is optimized from scratch
+            optimizer.reset();
+            result |= compile(edit->getBuffer(), OutputVars);
+            continue;
+        }
+        if (optimizer)
+            textOptimized = optimizer->update(edit->getBuffer());
+        else
+        {
+            fileBuffer = std::move(edit);
+            optimizer.reset(new Optimizer(fileBuffer->getBuffer()));
+            textOptimized = optimizer->optimize(OutputVars);
+        }
+        result |= compile(textOptimized, OutputVars);
+    }
+    return result;
+}
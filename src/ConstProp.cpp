@@ -0,0 +1,543 @@
+#include "ConstProp.h"
+#include "AssignedVars.h"
+#include "ConstantFolder.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+
+namespace cp{
+
+  Comparison *makeBool(bool Value)
+  {
+    return new Comparison(nullptr, nullptr, Value ? Comparison::True : Comparison::False);
+  }
+
+  // Forward constant propagation.
+  // Statements are visited in execution order with the set of variables known
+  // to hold a constant. Expressions and conditions are folded in place and every
+  // statement list is rebuilt, so pruned arms and loops simply are not emitted.
+  class ConstPropVisitor : public ASTVisitor
+  {
+    using ConstMap = llvm::StringMap<int>;
+
+    ConstMap Env;                   // variables that hold a known constant at the current point
+    llvm::StringSet<> BoolVars;     // variables declared as bool
+    llvm::SmallVector<AST *> Out;   // rewritten statements of the list being visited
+    AST *CurrentStmt = nullptr;     // statement being visited, to tell x++; from x++ inside an expression
+    bool Rewrite = true;            // false while a condition is only probed
+
+    // Result of the last visited expression or condition
+    bool Known;                     // its value is a constant
+    int Value;                      // the constant (0 or 1 for conditions)
+    bool SideEffect;                // it contains ++ or --, so it cannot be removed
+    bool IsLiteral;                 // it already is a number or true/false
+    bool IntLogic;                  // it is a condition naming an int variable (int copy)
+
+    void clearResult()
+    {
+      Known = false;
+      Value = 0;
+      SideEffect = false;
+      IsLiteral = false;
+      IntLogic = false;
+    }
+
+    bool lookup(llvm::StringRef Name, int &Val)
+    {
+      ConstMap::const_iterator I = Env.find(Name);
+      if (I == Env.end())
+        return false;
+      Val = I->second;
+      return true;
+    }
+
+    void setVar(llvm::StringRef Name, bool IsKnown, int Val)
+    {
+      if (IsKnown)
+        Env[Name] = Val;
+      else
+        Env.erase(Name);
+    }
+
+    // Keeps only the constants both states agree on (the join of two paths)
+    static void meet(ConstMap &Into, const ConstMap &Other)
+    {
+      llvm::SmallVector<llvm::StringRef, 8> Dead;
+      for (ConstMap::const_iterator I = Into.begin(), E = Into.end(); I != E; ++I)
+      {
+        ConstMap::const_iterator O = Other.find(I->getKey());
+        if (O == Other.end() || O->second != I->second)
+          Dead.push_back(I->getKey());
+      }
+      for (llvm::StringRef Name : Dead)
+        Into.erase(Name);
+    }
+
+    // Forgets every variable the given node may assign
+    void kill(AST *Node)
+    {
+      llvm::StringSet<> Vars;
+      AssignedVars Collector(Vars);
+      Node->accept(Collector);
+      for (llvm::StringSet<>::const_iterator I = Vars.begin(), E = Vars.end(); I != E; ++I)
+        Env.erase(I->getKey());
+    }
+
+    // Visits an expression and returns the node to use in its place
+    Expr *foldExpr(Expr *E)
+    {
+      E->accept(*this);
+      if (Rewrite && Known && !SideEffect && !IsLiteral)
+        return makeNumber(Value);
+      return E;
+    }
+
+    // Visits a condition and returns the node to use in its place
+    Logic *foldLogic(Logic *L)
+    {
+      L->accept(*this);
+      if (Rewrite && Known && !SideEffect && !IsLiteral && !IntLogic)
+        return makeBool(Value);
+      return L;
+    }
+
+    // Evaluates a condition in the current state without changing the tree or the state
+    bool neverTaken(Logic *Cond)
+    {
+      ConstMap Saved = Env;
+      Rewrite = false;
+      Cond->accept(*this);
+      Rewrite = true;
+      Env = Saved;
+      return Known && Value == 0 && !SideEffect && !IntLogic;
+    }
+
+    bool hasSideEffect(Logic *Cond)
+    {
+      ConstMap Saved = Env;
+      Rewrite = false;
+      Cond->accept(*this);
+      Rewrite = true;
+      Env = Saved;
+      return SideEffect;
+    }
+
+    // Rewrites a statement list in the current state and returns the new list
+    llvm::SmallVector<AST *> optimizeBody(llvm::SmallVector<AST *>::const_iterator I, llvm::SmallVector<AST *>::const_iterator E)
+    {
+      llvm::SmallVector<AST *> Saved = std::move(Out);
+      AST *SavedStmt = CurrentStmt;
+      Out.clear();
+      for (; I != E; ++I)
+      {
+        CurrentStmt = *I;
+        (*I)->accept(*this);
+      }
+      llvm::SmallVector<AST *> Body = std::move(Out);
+      Out = std::move(Saved);
+      CurrentStmt = SavedStmt;
+      return Body;
+    }
+
+    void foldAssignment(Assignment &Node)
+    {
+      llvm::StringRef Name = Node.getLeft()->getVal();
+      // CodeGen loads the old value before it evaluates the right-hand side
+      int Old = 0;
+      bool OldKnown = lookup(Name, Old);
+
+      if (Node.getRightExpr())
+        Node.setRightExpr(foldExpr(Node.getRightExpr()));
+      else
+      {
+        Logic *Folded = foldLogic(Node.getRightLogic());
+        if (Rewrite && IntLogic && !BoolVars.count(Name))
+        {
+          // a = b; with int b is parsed as a condition, turn it into a number or a plain copy
+          Node.setRightLogic(nullptr);
+          Node.setRightExpr(Known ? makeNumber(Value) : ((Comparison *)Folded)->getLeft());
+        }
+        else
+          Node.setRightLogic(Folded);
+      }
+      bool RightKnown = Known;
+      int RightValue = Value;
+      bool RightSideEffect = SideEffect;
+
+      bool NewKnown = RightKnown;
+      int NewValue = RightValue;
+      if (Node.getAssignKind() != Assignment::Assign)
+      {
+        NewKnown = OldKnown && RightKnown && ConstantFolder::assign(Node.getAssignKind(), Old, RightValue, NewValue);
+        if (Rewrite && NewKnown && !RightSideEffect)
+        {
+          Node.setAssignKind(Assignment::Assign);
+          Node.setRightExpr(makeNumber(NewValue));
+        }
+      }
+      setVar(Name, NewKnown, NewValue);
+    }
+
+  public:
+    ConstPropVisitor() { clearResult(); }
+
+    virtual void visit(Program &Node) override
+    {
+      Node.setdata(optimizeBody(Node.begin(), Node.end()));
+    };
+
+    virtual void visit(DeclarationInt &Node) override
+    {
+      // every initializer is evaluated before any of the variables is stored
+      llvm::SmallVector<Expr *> Values;
+      llvm::SmallVector<std::pair<bool, int>, 8> Results;
+      for (llvm::SmallVector<Expr *>::const_iterator I = Node.valBegin(), E = Node.valEnd(); I != E; ++I)
+      {
+        Values.push_back(foldExpr(*I));
+        Results.push_back(std::make_pair(Known, Value));
+      }
+      Node.setValues(Values);
+      unsigned Idx = 0;
+      for (llvm::SmallVector<llvm::StringRef>::const_iterator I = Node.varBegin(), E = Node.varEnd(); I != E; ++I, ++Idx)
+      {
+        if (Idx < Results.size())
+          setVar(*I, Results[Idx].first, Results[Idx].second);
+        else
+          setVar(*I, true, 0);
+      }
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(DeclarationBool &Node) override
+    {
+      llvm::SmallVector<Logic *> Values;
+      llvm::SmallVector<std::pair<bool, int>, 8> Results;
+      for (llvm::SmallVector<Logic *>::const_iterator I = Node.valBegin(), E = Node.valEnd(); I != E; ++I)
+      {
+        Values.push_back(foldLogic(*I));
+        Results.push_back(std::make_pair(Known, Value));
+      }
+      Node.setValues(Values);
+      unsigned Idx = 0;
+      for (llvm::SmallVector<llvm::StringRef>::const_iterator I = Node.varBegin(), E = Node.varEnd(); I != E; ++I, ++Idx)
+      {
+        BoolVars.insert(*I);
+        if (Idx < Results.size())
+          setVar(*I, Results[Idx].first, Results[Idx].second);
+        else
+          setVar(*I, true, 0);
+      }
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(Assignment &Node) override
+    {
+      foldAssignment(Node);
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(Final &Node) override
+    {
+      clearResult();
+      if (Node.getKind() == Final::Number)
+      {
+        IsLiteral = true;
+        Known = ConstantFolder::number(Node.getVal(), Value);
+      }
+      else
+        Known = lookup(Node.getVal(), Value);
+    };
+
+    virtual void visit(BinaryOp &Node) override
+    {
+      Expr *Left = foldExpr(Node.getLeft());
+      bool LeftKnown = Known, LeftSideEffect = SideEffect;
+      int LeftValue = Value;
+
+      Expr *Right = foldExpr(Node.getRight());
+      bool RightKnown = Known, RightSideEffect = SideEffect;
+      int RightValue = Value;
+
+      Node.setLeft(Left);
+      Node.setRight(Right);
+
+      clearResult();
+      SideEffect = LeftSideEffect || RightSideEffect;
+      Known = LeftKnown && RightKnown && ConstantFolder::binary(Node.getOperator(), LeftValue, RightValue, Value, Node.wraps());
+    };
+
+    virtual void visit(UnaryOp &Node) override
+    {
+      int Old;
+      bool OldKnown = lookup(Node.getIdent(), Old);
+      int NewValue = 0;
+      bool NewKnown = OldKnown && ConstantFolder::unary(Node.getOperator(), Old, NewValue);
+      setVar(Node.getIdent(), NewKnown, NewValue);
+
+      if (&Node == CurrentStmt)
+      {
+        // x++; on its own: store the known result directly
+        if (NewKnown)
+          Out.push_back(new Assignment(new Final(Final::Ident, Node.getIdent()), makeNumber(NewValue), Assignment::Assign, nullptr));
+        else
+          Out.push_back(&Node);
+        return;
+      }
+      clearResult();
+      SideEffect = true;
+      Known = NewKnown;
+      Value = NewValue;
+    };
+
+    virtual void visit(SignedNumber &Node) override
+    {
+      clearResult();
+      IsLiteral = true;
+      Known = ConstantFolder::signedNumber(Node.getSign(), Node.getValue(), Value);
+    };
+
+    virtual void visit(NegExpr &Node) override
+    {
+      Node.setExpr(foldExpr(Node.getExpr()));
+      IsLiteral = false;
+      Value = ConstantFolder::neg(Value);
+    };
+
+    virtual void visit(Comparison &Node) override
+    {
+      if (Node.getRight() == nullptr)
+      {
+        clearResult();
+        switch (Node.getOperator())
+        {
+        case Comparison::True:
+          Known = IsLiteral = true;
+          Value = 1;
+          break;
+        case Comparison::False:
+          Known = IsLiteral = true;
+          Value = 0;
+          break;
+        case Comparison::Ident:
+        {
+          llvm::StringRef Name = ((Final *)Node.getLeft())->getVal();
+          Known = lookup(Name, Value);
+          IntLogic = !BoolVars.count(Name);
+          break;
+        }
+        default:
+          break;
+        }
+        return;
+      }
+      Expr *Left = foldExpr(Node.getLeft());
+      bool LeftKnown = Known, LeftSideEffect = SideEffect;
+      int LeftValue = Value;
+
+      Expr *Right = foldExpr(Node.getRight());
+      bool RightKnown = Known, RightSideEffect = SideEffect;
+      int RightValue = Value;
+
+      Node.setLeft(Left);
+      Node.setRight(Right);
+
+      clearResult();
+      SideEffect = LeftSideEffect || RightSideEffect;
+      Known = LeftKnown && RightKnown;
+      Value = ConstantFolder::comparison(Node.getOperator(), LeftValue, RightValue);
+    };
+
+    virtual void visit(LogicalExpr &Node) override
+    {
+      Logic *Left = foldLogic(Node.getLeft());
+      Node.setLeft(Left);
+      if (Node.getRight() == nullptr)
+        return;
+      bool LeftKnown = Known, LeftSideEffect = SideEffect;
+      int LeftValue = Value;
+
+      Logic *Right = foldLogic(Node.getRight());
+      bool RightKnown = Known, RightSideEffect = SideEffect;
+      int RightValue = Value;
+      Node.setRight(Right);
+
+      clearResult();
+      SideEffect = LeftSideEffect || RightSideEffect;
+      // one constant side is enough when it decides the result
+      int Decisive = Node.getOperator() == LogicalExpr::And ? 0 : 1;
+      if (LeftKnown && RightKnown)
+      {
+        Known = true;
+        Value = ConstantFolder::logical(Node.getOperator(), LeftValue, RightValue);
+      }
+      else if ((LeftKnown && LeftValue == Decisive) || (RightKnown && RightValue == Decisive))
+      {
+        Known = true;
+        Value = Decisive;
+      }
+    };
+
+    virtual void visit(PrintStmt &Node) override
+    {
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(IfStmt &Node) override
+    {
+      struct Arm
+      {
+        Logic *Cond;
+        llvm::SmallVector<AST *> Body;
+        elifStmt *Elif;
+      };
+      llvm::SmallVector<Arm, 4> Arms;
+      Arms.push_back({Node.getCond(), llvm::SmallVector<AST *>(Node.begin(), Node.end()), nullptr});
+      for (llvm::SmallVector<elifStmt *>::const_iterator I = Node.beginElif(), E = Node.endElif(); I != E; ++I)
+        Arms.push_back({(*I)->getCond(), llvm::SmallVector<AST *>((*I)->begin(), (*I)->end()), *I});
+      llvm::SmallVector<AST *> Else(Node.beginElse(), Node.endElse());
+
+      bool CondSideEffect = false;
+      for (Arm &A : Arms)
+        CondSideEffect |= hasSideEffect(A.Cond);
+      if (CondSideEffect)
+      {
+        // a condition changes a variable, so the state depends on how many of them ran:
+        // keep every arm and only fold with what no part of the statement changes
+        kill(&Node);
+        ConstMap Entry = Env;
+        Node.setCond(foldLogic(Node.getCond()));
+        Node.setBody(optimizeBody(Arms[0].Body.begin(), Arms[0].Body.end()));
+        for (unsigned I = 1; I < Arms.size(); ++I)
+        {
+          Env = Entry;
+          Arms[I].Elif->setCond(foldLogic(Arms[I].Cond));
+          Arms[I].Elif->setBody(optimizeBody(Arms[I].Body.begin(), Arms[I].Body.end()));
+        }
+        Env = Entry;
+        Node.setElse(optimizeBody(Else.begin(), Else.end()));
+        Env = Entry;
+        Out.push_back(&Node);
+        return;
+      }
+
+      ConstMap Entry = Env;
+      llvm::SmallVector<ConstMap, 4> Exits;
+      Logic *IfCond = nullptr;
+      llvm::SmallVector<AST *> IfBody;
+      llvm::SmallVector<elifStmt *> Elifs;
+      llvm::SmallVector<AST *> ElseBody;
+      bool HasElse = false;
+
+      for (Arm &A : Arms)
+      {
+        // conditions have no side effects, so each arm starts from the entry state
+        Env = Entry;
+        Logic *Cond = foldLogic(A.Cond);
+        if (Known && Value == 0)
+          continue; // never taken
+        bool Always = Known;
+        llvm::SmallVector<AST *> Body = optimizeBody(A.Body.begin(), A.Body.end());
+        Exits.push_back(Env);
+        if (Always)
+        {
+          // taken whenever it is reached, so it becomes the else and the rest is unreachable
+          ElseBody = Body;
+          HasElse = true;
+          break;
+        }
+        if (!IfCond)
+        {
+          IfCond = Cond;
+          IfBody = Body;
+        }
+        else
+        {
+          elifStmt *Elif = A.Elif ? A.Elif : new elifStmt(Cond, Body);
+          Elif->setCond(Cond);
+          Elif->setBody(Body);
+          Elifs.push_back(Elif);
+        }
+      }
+      if (!HasElse && !Else.empty())
+      {
+        Env = Entry;
+        ElseBody = optimizeBody(Else.begin(), Else.end());
+        Exits.push_back(Env);
+        HasElse = true;
+      }
+      if (!HasElse)
+        Exits.push_back(Entry); // no arm taken
+
+      Env = Exits[0];
+      for (unsigned I = 1; I < Exits.size(); ++I)
+        meet(Env, Exits[I]);
+
+      if (!IfCond)
+      {
+        // no conditional arm is left: only the unconditional one (if any) runs
+        Out.append(ElseBody.begin(), ElseBody.end());
+        return;
+      }
+      Node.setCond(IfCond);
+      Node.setBody(IfBody);
+      Node.setElifs(Elifs);
+      Node.setElse(ElseBody);
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(elifStmt &Node) override
+    {
+      Node.setCond(foldLogic(Node.getCond()));
+      Node.setBody(optimizeBody(Node.begin(), Node.end()));
+    };
+
+    virtual void visit(WhileStmt &Node) override
+    {
+      if (neverTaken(Node.getCond()))
+        return;
+      // the loop state: everything the loop may change is unknown on every iteration
+      kill(&Node);
+      ConstMap LoopEnv = Env;
+      Node.setCond(foldLogic(Node.getCond()));
+      Node.setBody(optimizeBody(Node.begin(), Node.end()));
+      Env = LoopEnv;
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(ForStmt &Node) override
+    {
+      foldAssignment(*Node.getFirst());
+      if (neverTaken(Node.getSecond()))
+      {
+        // only the initialization runs
+        Out.push_back(Node.getFirst());
+        return;
+      }
+      kill(Node.getSecond());
+      if (Node.getThirdAssign())
+        kill(Node.getThirdAssign());
+      else
+        kill(Node.getThirdUnary());
+      for (llvm::SmallVector<AST *>::const_iterator I = Node.begin(), E = Node.end(); I != E; ++I)
+        kill(*I);
+      ConstMap LoopEnv = Env;
+
+      Node.setSecond(foldLogic(Node.getSecond()));
+      Node.setBody(optimizeBody(Node.begin(), Node.end()));
+      // the step runs right after the body, in the state the body leaves
+      if (Node.getThirdAssign())
+        foldAssignment(*Node.getThirdAssign());
+      else
+        Node.getThirdUnary()->accept(*this);
+      Env = LoopEnv;
+      Out.push_back(&Node);
+    };
+  };
+}
+
+void ConstProp::optimize(Program *Tree)
+{
+  if (!Tree)
+    return;
+  cp::ConstPropVisitor Folder;
+  Tree->accept(Folder);
+}
@@ -0,0 +1,22 @@
+#ifndef CONSTPROP_H
+#define CONSTPROP_H
+
+#include "AST.h"
+#include "ASTPass.h"
+
+// Flow-sensitive constant propagation over the AST.
+// Folds constant expressions and conditions, merges the known constants
+// at control-flow joins and removes if/elif/else arms and loops that can
+// never run.
+class ConstProp : public ASTPass
+{
+public:
+  void optimize(Program *Tree);
+
+  virtual void visit(Program &Node) override
+  {
+    optimize(&Node);
+  };
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include "ConstantFolder.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/StringSaver.h"
+#include <cstdint>
+#include <string>
+
+// A number literal, which CodeGen reads with getAsInteger into an int
+bool ConstantFolder::number(llvm::StringRef Text, int &Result)
+{
+  return !Text.getAsInteger(10, Result);
+}
+
+bool ConstantFolder::signedNumber(SignedNumber::Sign Sign, llvm::StringRef Text, int &Result)
+{
+  if (!number(Text, Result))
+    return false;
+  // the literal is at most INT32_MAX, so its negation can not overflow
+  if (Sign == SignedNumber::Minus)
+    Result = -Result;
+  return true;
+}
+
+bool ConstantFolder::binary(BinaryOp::Operator Op, int Left, int Right, int &Result, bool Wraps)
+{
+  int64_t Wide;
+  switch (Op)
+  {
+  case BinaryOp::Plus:
+    Wide = (int64_t)Left + Right;
+    break;
+  case BinaryOp::Minus:
+    Wide = (int64_t)Left - Right;
+    break;
+  case BinaryOp::Mul:
+    Wide = (int64_t)Left * Right;
+    break;
+  case BinaryOp::Div:
+    if (Right == 0 || (Left == INT32_MIN && Right == -1))
+      return false;
+    Wide = Left / Right;
+    break;
+  case BinaryOp::Mod:
+    if (Right == 0 || (Left == INT32_MIN && Right == -1))
+      return false;
+    Wide = Left % Right;
+    break;
+  case BinaryOp::Exp:
+  {
+    // CodeGen multiplies Right times without overflow flags, a non-positive exponent gives 1
+    uint32_t Base = (uint32_t)Left;
+    uint32_t Power = 1;
+    for (int Count = Right; Count > 0; Count >>= 1)
+    {
+      if (Count & 1)
+        Power *= Base;
+      Base *= Base;
+    }
+    Result = (int)Power;
+    return true;
+  }
+  default:
+    return false;
+  }
+  if (Wraps)
+  {
+    Result = (int)(uint32_t)Wide;
+    return true;
+  }
+  if (Wide < INT32_MIN || Wide > INT32_MAX)
+    return false;
+  Result = (int)Wide;
+  return true;
+}
+
+bool ConstantFolder::unary(UnaryOp::Operator Op, int Value, int &Result)
+{
+  return binary(Op == UnaryOp::Plus_plus ? BinaryOp::Plus : BinaryOp::Minus, Value, 1, Result);
+}
+
+int ConstantFolder::neg(int Value)
+{
+  // CreateNeg has no overflow flags, so -INT_MIN is INT_MIN
+  return (int)(0u - (uint32_t)Value);
+}
+
+int ConstantFolder::comparison(Comparison::Operator Op, int Left, int Right)
+{
+  switch (Op)
+  {
+  case Comparison::Equal:
+    return Left == Right;
+  case Comparison::Not_equal:
+    return Left != Right;
+  case Comparison::Greater:
+    return Left > Right;
+  case Comparison::Less:
+    return Left < Right;
+  case Comparison::Greater_equal:
+    return Left >= Right;
+  case Comparison::Less_equal:
+    return Left <= Right;
+  case Comparison::True:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+int ConstantFolder::logical(LogicalExpr::Operator Op, int Left, int Right)
+{
+  // both sides are always evaluated, and/or are the i1 and/or
+  if (Op == LogicalExpr::And)
+    return Left && Right;
+  return Left || Right;
+}
+
+bool ConstantFolder::assign(Assignment::AssignKind Kind, int Old, int Right, int &Result)
+{
+  switch (Kind)
+  {
+  case Assignment::Assign:
+    Result = Right;
+    return true;
+  case Assignment::Plus_assign:
+    return binary(BinaryOp::Plus, Old, Right, Result);
+  case Assignment::Minus_assign:
+    return binary(BinaryOp::Minus, Old, Right, Result);
+  case Assignment::Star_assign:
+    return binary(BinaryOp::Mul, Old, Right, Result);
+  case Assignment::Slash_assign:
+    return binary(BinaryOp::Div, Old, Right, Result);
+  default:
+    return false;
+  }
+}
+
+Final *makeNumber(int Value)
+{
+  static llvm::BumpPtrAllocator Allocator;
+  static llvm::StringSaver Saver(Allocator);
+  return new Final(Final::Number, Saver.save(std::to_string(Value)));
+}
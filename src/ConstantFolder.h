@@ -0,0 +1,30 @@
+#ifndef CONSTANTFOLDER_H
+#define CONSTANTFOLDER_H
+
+#include "AST.h"
+
+// Folds the operators of the language on constants with the exact i32
+// semantics of the IR that CodeGen emits (nsw add/sub/mul, sdiv, srem,
+// the wrapping multiply loop of ^, wrapping negation, i1 and/or).
+// A function returns false instead of folding when that IR would produce
+// poison or undefined behaviour: signed overflow, division or remainder
+// by zero and INT_MIN / -1. Conditions fold to 0 or 1. The + - * of
+// BinaryOp::wraps() nodes have no overflow flags and fold modulo 2^32.
+class ConstantFolder
+{
+public:
+  static bool number(llvm::StringRef Text, int &Result);
+  static bool signedNumber(SignedNumber::Sign Sign, llvm::StringRef Text, int &Result);
+  static bool binary(BinaryOp::Operator Op, int Left, int Right, int &Result, bool Wraps = false);
+  static bool unary(UnaryOp::Operator Op, int Value, int &Result);
+  static int neg(int Value);
+  static int comparison(Comparison::Operator Op, int Left, int Right);
+  static int logical(LogicalExpr::Operator Op, int Left, int Right);
+  static bool assign(Assignment::AssignKind Kind, int Old, int Right, int &Result);
+};
+
+// Creates a number literal for a folded value. The AST only keeps StringRefs,
+// so the text is saved for the rest of the compilation.
+Final *makeNumber(int Value);
+
+#endif
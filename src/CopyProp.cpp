@@ -0,0 +1,349 @@
+#include "CopyProp.h"
+#include "AssignedVars.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+
+namespace cpy{
+
+  // The copies that hold at a point of the program
+  struct CopyState
+  {
+    llvm::StringMap<llvm::StringRef> Source;                        // variable -> the variable it is a copy of
+    llvm::StringMap<llvm::SmallVector<llvm::StringRef, 2>> Copies;  // variable -> the variables copied from it, may be stale
+
+    llvm::StringRef lookup(llvm::StringRef Name) const
+    {
+      return Source.lookup(Name);
+    }
+
+    void record(llvm::StringRef Name, llvm::StringRef From)
+    {
+      Source[Name] = From;
+      Copies[From].push_back(Name);
+    }
+
+    // A variable is assigned: it is no copy any more and its copies no longer hold its value
+    void kill(llvm::StringRef Name)
+    {
+      Source.erase(Name);
+      llvm::StringMap<llvm::SmallVector<llvm::StringRef, 2>>::iterator I = Copies.find(Name);
+      if (I == Copies.end())
+        return;
+      for (llvm::StringRef Copy : I->second)
+      {
+        llvm::StringMap<llvm::StringRef>::iterator C = Source.find(Copy);
+        if (C != Source.end() && C->second == Name)
+          Source.erase(C);
+      }
+      Copies.erase(I);
+    }
+
+    // Keeps only the copies both states agree on (the join of two paths)
+    void meet(const CopyState &Other)
+    {
+      llvm::SmallVector<llvm::StringRef, 8> Dead;
+      for (llvm::StringMap<llvm::StringRef>::const_iterator I = Source.begin(), E = Source.end(); I != E; ++I)
+        if (Other.lookup(I->getKey()) != I->second)
+          Dead.push_back(I->getKey());
+      for (llvm::StringRef Name : Dead)
+        Source.erase(Name);
+    }
+  };
+
+  // Finds the variable a value consists of, if it is a single variable
+  class PlainVar : public ASTVisitor
+  {
+  public:
+    Final *Var = nullptr;
+
+    virtual void visit(Final &Node) override
+    {
+      if (Node.getKind() == Final::Ident)
+        Var = &Node;
+    };
+
+    virtual void visit(Comparison &Node) override
+    {
+      // a = b; is parsed as a condition that only names b
+      if (Node.getOperator() == Comparison::Ident)
+        Node.getLeft()->accept(*this);
+    };
+
+    virtual void visit(BinaryOp &Node) override {};
+    virtual void visit(UnaryOp &Node) override {};
+    virtual void visit(SignedNumber &Node) override {};
+    virtual void visit(NegExpr &Node) override {};
+    virtual void visit(LogicalExpr &Node) override {};
+    virtual void visit(Assignment &Node) override {};
+    virtual void visit(DeclarationInt &Node) override {};
+    virtual void visit(DeclarationBool &Node) override {};
+    virtual void visit(IfStmt &Node) override {};
+    virtual void visit(WhileStmt &Node) override {};
+    virtual void visit(elifStmt &Node) override {};
+    virtual void visit(ForStmt &Node) override {};
+    virtual void visit(PrintStmt &Node) override {};
+  };
+
+  // Forward copy propagation.
+  // Statements are visited in execution order with the copies that hold at
+  // that point. Reads are rewritten in place, and every statement list is
+  // rebuilt so a print can be replaced by a print of the source.
+  class CopyPropVisitor : public ASTVisitor
+  {
+    CopyState State;
+    llvm::StringSet<> BoolVars;     // variables declared as bool
+    llvm::SmallVector<AST *> Out;   // rewritten statements of the list being visited
+    AST *CurrentStmt = nullptr;     // statement being visited, to tell x++; from x++ inside an expression
+    Expr *Replacement = nullptr;    // set by visit(Final) when the read is replaced
+
+    // Forgets every copy the given node may break
+    void kill(AST *Node)
+    {
+      llvm::StringSet<> Vars;
+      AssignedVars Collector(Vars);
+      Node->accept(Collector);
+      for (llvm::StringSet<>::const_iterator I = Vars.begin(), E = Vars.end(); I != E; ++I)
+        State.kill(I->getKey());
+    }
+
+    // Visits an expression and returns the node to use in its place
+    Expr *rewrite(Expr *E)
+    {
+      Replacement = nullptr;
+      E->accept(*this);
+      Expr *Result = Replacement ? Replacement : E;
+      Replacement = nullptr;
+      return Result;
+    }
+
+    // The variable Name becomes a copy of by storing Value: a plain variable of the same type
+    llvm::StringRef copiedVar(AST *Value, llvm::StringRef Name)
+    {
+      PlainVar Finder;
+      Value->accept(Finder);
+      if (!Finder.Var || Finder.Var->getVal() == Name)
+        return "";
+      if (BoolVars.count(Finder.Var->getVal()) != BoolVars.count(Name))
+        return "";
+      return Finder.Var->getVal();
+    }
+
+    // Rewrites a statement list in the current state and returns the new list
+    llvm::SmallVector<AST *> optimizeBody(llvm::SmallVector<AST *>::const_iterator I, llvm::SmallVector<AST *>::const_iterator E)
+    {
+      llvm::SmallVector<AST *> Saved = std::move(Out);
+      AST *SavedStmt = CurrentStmt;
+      Out.clear();
+      for (; I != E; ++I)
+      {
+        CurrentStmt = *I;
+        (*I)->accept(*this);
+      }
+      llvm::SmallVector<AST *> Body = std::move(Out);
+      Out = std::move(Saved);
+      CurrentStmt = SavedStmt;
+      return Body;
+    }
+
+    void propagate(Assignment &Node)
+    {
+      llvm::StringRef Name = Node.getLeft()->getVal();
+      llvm::StringRef From;
+      if (Node.getRightExpr())
+      {
+        Node.setRightExpr(rewrite(Node.getRightExpr()));
+        From = copiedVar(Node.getRightExpr(), Name);
+      }
+      else
+      {
+        Node.getRightLogic()->accept(*this);
+        From = copiedVar(Node.getRightLogic(), Name);
+      }
+      State.kill(Name);
+      if (Node.getAssignKind() == Assignment::Assign && !From.empty())
+        State.record(Name, From);
+    }
+
+  public:
+    virtual void visit(Program &Node) override
+    {
+      Node.setdata(optimizeBody(Node.begin(), Node.end()));
+    };
+
+    virtual void visit(DeclarationInt &Node) override
+    {
+      // every initializer is evaluated before any of the variables is stored
+      llvm::SmallVector<Expr *> Values;
+      for (llvm::SmallVector<Expr *>::const_iterator I = Node.valBegin(), E = Node.valEnd(); I != E; ++I)
+        Values.push_back(rewrite(*I));
+      Node.setValues(Values);
+      unsigned Idx = 0;
+      for (llvm::SmallVector<llvm::StringRef>::const_iterator I = Node.varBegin(), E = Node.varEnd(); I != E; ++I, ++Idx)
+      {
+        State.kill(*I);
+        if (Idx < Values.size())
+        {
+          llvm::StringRef From = copiedVar(Values[Idx], *I);
+          if (!From.empty())
+            State.record(*I, From);
+        }
+      }
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(DeclarationBool &Node) override
+    {
+      for (llvm::SmallVector<Logic *>::const_iterator I = Node.valBegin(), E = Node.valEnd(); I != E; ++I)
+        (*I)->accept(*this);
+      unsigned Idx = 0;
+      llvm::SmallVector<Logic *>::const_iterator V = Node.valBegin();
+      for (llvm::SmallVector<llvm::StringRef>::const_iterator I = Node.varBegin(), E = Node.varEnd(); I != E; ++I, ++Idx)
+      {
+        BoolVars.insert(*I);
+        State.kill(*I);
+        if (V + Idx < Node.valEnd())
+        {
+          llvm::StringRef From = copiedVar(*(V + Idx), *I);
+          if (!From.empty())
+            State.record(*I, From);
+        }
+      }
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(Assignment &Node) override
+    {
+      propagate(Node);
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(Final &Node) override
+    {
+      if (Node.getKind() != Final::Ident)
+        return;
+      llvm::StringRef From = State.lookup(Node.getVal());
+      if (!From.empty())
+        Replacement = new Final(Final::Ident, From);
+    };
+
+    virtual void visit(BinaryOp &Node) override
+    {
+      Node.setLeft(rewrite(Node.getLeft()));
+      Node.setRight(rewrite(Node.getRight()));
+    };
+
+    virtual void visit(UnaryOp &Node) override
+    {
+      // x++ reads and assigns x, so it is never rewritten
+      State.kill(Node.getIdent());
+      if (&Node == CurrentStmt)
+        Out.push_back(&Node);
+    };
+
+    virtual void visit(SignedNumber &Node) override {};
+
+    virtual void visit(NegExpr &Node) override
+    {
+      Node.setExpr(rewrite(Node.getExpr()));
+    };
+
+    virtual void visit(Comparison &Node) override
+    {
+      if (Node.getLeft())
+        Node.setLeft(rewrite(Node.getLeft()));
+      if (Node.getRight())
+        Node.setRight(rewrite(Node.getRight()));
+    };
+
+    virtual void visit(LogicalExpr &Node) override
+    {
+      if (Node.getLeft())
+        Node.getLeft()->accept(*this);
+      if (Node.getRight())
+        Node.getRight()->accept(*this);
+    };
+
+    virtual void visit(PrintStmt &Node) override
+    {
+      llvm::StringRef From = State.lookup(Node.getVar());
+      Out.push_back(From.empty() ? &Node : new PrintStmt(From));
+    };
+
+    virtual void visit(IfStmt &Node) override
+    {
+      // a condition that assigns a variable makes the state depend on how many
+      // conditions ran, so only the copies no part of the statement breaks are used
+      llvm::StringSet<> CondVars;
+      AssignedVars Collector(CondVars);
+      Node.getCond()->accept(Collector);
+      for (llvm::SmallVector<elifStmt *>::const_iterator I = Node.beginElif(), E = Node.endElif(); I != E; ++I)
+        (*I)->getCond()->accept(Collector);
+      if (!CondVars.empty())
+        kill(&Node);
+
+      CopyState Entry = State;
+      Node.getCond()->accept(*this);
+      Node.setBody(optimizeBody(Node.begin(), Node.end()));
+      CopyState Exit = State;
+      for (llvm::SmallVector<elifStmt *>::const_iterator I = Node.beginElif(), E = Node.endElif(); I != E; ++I)
+      {
+        State = Entry;
+        (*I)->accept(*this);
+        Exit.meet(State);
+      }
+      State = Entry;
+      Node.setElse(optimizeBody(Node.beginElse(), Node.endElse()));
+      Exit.meet(State);
+      State = CondVars.empty() ? std::move(Exit) : std::move(Entry);
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(elifStmt &Node) override
+    {
+      Node.getCond()->accept(*this);
+      Node.setBody(optimizeBody(Node.begin(), Node.end()));
+    };
+
+    virtual void visit(WhileStmt &Node) override
+    {
+      // the loop state: no copy the loop may break holds on any iteration
+      kill(&Node);
+      CopyState LoopState = State;
+      Node.getCond()->accept(*this);
+      Node.setBody(optimizeBody(Node.begin(), Node.end()));
+      State = std::move(LoopState);
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(ForStmt &Node) override
+    {
+      propagate(*Node.getFirst());
+      kill(Node.getSecond());
+      if (Node.getThirdAssign())
+        kill(Node.getThirdAssign());
+      else
+        kill(Node.getThirdUnary());
+      for (llvm::SmallVector<AST *>::const_iterator I = Node.begin(), E = Node.end(); I != E; ++I)
+        kill(*I);
+      CopyState LoopState = State;
+
+      Node.getSecond()->accept(*this);
+      Node.setBody(optimizeBody(Node.begin(), Node.end()));
+      // the step runs right after the body, in the state the body leaves
+      if (Node.getThirdAssign())
+        propagate(*Node.getThirdAssign());
+      else
+        Node.getThirdUnary()->accept(*this);
+      State = std::move(LoopState);
+      Out.push_back(&Node);
+    };
+  };
+}
+
+void CopyProp::optimize(Program *Tree)
+{
+  if (!Tree)
+    return;
+  cpy::CopyPropVisitor Propagator;
+  Tree->accept(Propagator);
+}
@@ -0,0 +1,23 @@
+#ifndef COPYPROP_H
+#define COPYPROP_H
+
+#include "AST.h"
+#include "ASTPass.h"
+
+// Copy propagation over the AST.
+// After t = x; or int t = x;, reads of t are replaced by reads of x for as
+// long as neither variable is assigned again, so the copies become dead
+// and the dead code elimination removes them. A copy made before a loop
+// does not reach into it when the loop assigns either variable.
+class CopyProp : public ASTPass
+{
+public:
+  void optimize(Program *Tree);
+
+  virtual void visit(Program &Node) override
+  {
+    optimize(&Node);
+  };
+};
+
+#endif
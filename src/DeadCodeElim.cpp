@@ -0,0 +1,470 @@
+#include "DeadCodeElim.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+
+namespace dce{
+
+  // Collects the variables an expression or condition reads
+  class ReadVars : public ASTVisitor
+  {
+    llvm::StringSet<> &Vars;
+
+  public:
+    bool SideEffect = false;        // it contains ++ or --
+
+    ReadVars(llvm::StringSet<> &Vars) : Vars(Vars) {}
+
+    virtual void visit(Final &Node) override
+    {
+      if (Node.getKind() == Final::Ident)
+        Vars.insert(Node.getVal());
+    };
+
+    virtual void visit(BinaryOp &Node) override
+    {
+      Node.getLeft()->accept(*this);
+      Node.getRight()->accept(*this);
+    };
+
+    virtual void visit(UnaryOp &Node) override
+    {
+      // x++ inside an expression reads x before it stores it
+      Vars.insert(Node.getIdent());
+      SideEffect = true;
+    };
+
+    virtual void visit(SignedNumber &Node) override {};
+
+    virtual void visit(NegExpr &Node) override
+    {
+      Node.getExpr()->accept(*this);
+    };
+
+    virtual void visit(Comparison &Node) override
+    {
+      if (Node.getLeft())
+        Node.getLeft()->accept(*this);
+      if (Node.getRight())
+        Node.getRight()->accept(*this);
+    };
+
+    virtual void visit(LogicalExpr &Node) override
+    {
+      if (Node.getLeft())
+        Node.getLeft()->accept(*this);
+      if (Node.getRight())
+        Node.getRight()->accept(*this);
+    };
+
+    // statements are never read, they are handled by the liveness visitor
+    virtual void visit(Assignment &Node) override {};
+    virtual void visit(DeclarationInt &Node) override {};
+    virtual void visit(DeclarationBool &Node) override {};
+    virtual void visit(IfStmt &Node) override {};
+    virtual void visit(WhileStmt &Node) override {};
+    virtual void visit(elifStmt &Node) override {};
+    virtual void visit(ForStmt &Node) override {};
+    virtual void visit(PrintStmt &Node) override {};
+  };
+
+  // Backward liveness.
+  // Statements are visited in reverse execution order with the set of variables
+  // whose current value may still reach a root. A statement that only defines
+  // variables outside that set is dropped while its statement list is rebuilt.
+  // Loops are first probed without changing the tree until their live set is stable.
+  // The live set only grows while an enclosing loop is probed, so every loop starts
+  // from the head set it reached the last time; a nested loop that is already stable
+  // then costs one walk of its body per probe instead of a fixpoint of its own.
+  class DeadCodeVisitor : public ASTVisitor
+  {
+    llvm::StringSet<> Live;         // variables whose value may reach a root from the current point
+    llvm::StringSet<> Referenced;   // variables named by a kept statement, to prune declarations
+    llvm::SmallVector<AST *> Out;   // kept statements of the list being visited, in reverse
+    bool Rewrite = true;            // false while a loop body is only probed
+    bool Kept;                      // the last visited statement stays in the program
+
+    // The next kept statement naming a variable, when it is a plain assignment that does
+    // not read it. A dead declaration of the variable in the same list is dropped and the
+    // assignment declares the variable instead.
+    struct SinkTarget
+    {
+      unsigned List;                // the statement list it is in
+      size_t Index;                 // its position in Out
+      Assignment *Node;
+    };
+    llvm::StringMap<SinkTarget> Sinkable;
+    llvm::DenseMap<AST *, llvm::StringSet<>> Heads; // the last live set at the head of each loop
+    unsigned List = 0;              // the statement list being visited
+    unsigned Lists = 0;
+
+    // Adds the variables a node reads to the live set and returns true if it has side effects
+    bool use(AST *Node)
+    {
+      llvm::StringSet<> Vars;
+      ReadVars Collector(Vars);
+      Node->accept(Collector);
+      for (llvm::StringSet<>::const_iterator I = Vars.begin(), E = Vars.end(); I != E; ++I)
+      {
+        Live.insert(I->getKey());
+        Sinkable.erase(I->getKey());
+        if (Rewrite)
+          Referenced.insert(I->getKey());
+      }
+      return Collector.SideEffect;
+    }
+
+    bool reads(AST *Node, llvm::StringRef Name)
+    {
+      llvm::StringSet<> Vars;
+      ReadVars Collector(Vars);
+      Node->accept(Collector);
+      return Vars.count(Name);
+    }
+
+    bool hasSideEffect(AST *Node)
+    {
+      llvm::StringSet<> Vars;
+      ReadVars Collector(Vars);
+      Node->accept(Collector);
+      return Collector.SideEffect;
+    }
+
+    void reference(llvm::StringRef Name)
+    {
+      Sinkable.erase(Name);
+      if (Rewrite)
+        Referenced.insert(Name);
+    }
+
+    // Turns the assignment the dead declaration of Name can move to into that declaration.
+    // Int variables need an expression on the right-hand side, bool variables a condition.
+    bool sink(llvm::StringRef Name, bool IsBool)
+    {
+      llvm::StringMap<SinkTarget>::iterator It = Sinkable.find(Name);
+      if (It == Sinkable.end() || It->second.List != List)
+        return false;
+      Assignment *Target = It->second.Node;
+      llvm::SmallVector<llvm::StringRef> Vars;
+      Vars.push_back(Name);
+      if (IsBool && Target->getRightLogic())
+        Out[It->second.Index] = new DeclarationBool(Vars, llvm::SmallVector<Logic *>(1, Target->getRightLogic()));
+      else if (!IsBool && Target->getRightExpr())
+        Out[It->second.Index] = new DeclarationInt(Vars, llvm::SmallVector<Expr *>(1, Target->getRightExpr()));
+      else
+        return false;
+      Sinkable.erase(It);
+      return true;
+    }
+
+    static bool sameSet(const llvm::StringSet<> &A, const llvm::StringSet<> &B)
+    {
+      if (A.size() != B.size())
+        return false;
+      for (llvm::StringSet<>::const_iterator I = A.begin(), E = A.end(); I != E; ++I)
+        if (!B.count(I->getKey()))
+          return false;
+      return true;
+    }
+
+    static void merge(llvm::StringSet<> &Into, const llvm::StringSet<> &Other)
+    {
+      for (llvm::StringSet<>::const_iterator I = Other.begin(), E = Other.end(); I != E; ++I)
+        Into.insert(I->getKey());
+    }
+
+    // Rewrites a statement list backwards from the current live set and returns the kept statements
+    llvm::SmallVector<AST *> optimizeBody(llvm::SmallVector<AST *>::const_iterator Begin, llvm::SmallVector<AST *>::const_iterator End)
+    {
+      llvm::SmallVector<AST *> Saved = std::move(Out);
+      unsigned SavedList = List;
+      Out.clear();
+      List = ++Lists;
+      for (llvm::SmallVector<AST *>::const_iterator I = End; I != Begin;)
+      {
+        --I;
+        (*I)->accept(*this);
+      }
+      llvm::SmallVector<AST *> Body(Out.rbegin(), Out.rend());
+      Out = std::move(Saved);
+      List = SavedList;
+      return Body;
+    }
+
+    // Live set before an assignment that is always executed (for loop headers)
+    void keepAssignment(Assignment &Node)
+    {
+      llvm::StringRef Name = Node.getLeft()->getVal();
+      if (Node.getAssignKind() == Assignment::Assign)
+        Live.erase(Name);
+      else
+        Live.insert(Name);
+      reference(Name);
+      if (Node.getRightExpr())
+        use(Node.getRightExpr());
+      else
+        use(Node.getRightLogic());
+    }
+
+    // Live set at the head of a loop whose body and step leave the program in Exit.
+    // Body stands for everything that runs between two evaluations of the condition.
+    template <typename BodyFn>
+    llvm::StringSet<> loopHead(AST *Loop, Logic *Cond, const llvm::StringSet<> &Exit, BodyFn Body)
+    {
+      llvm::StringSet<> &Known = Heads[Loop];
+      Live = Exit;
+      merge(Live, Known);
+      use(Cond);
+      llvm::StringSet<> Head = Live;
+      bool SavedRewrite = Rewrite;
+      Rewrite = false;
+      while (true)
+      {
+        Live = Head;
+        Body();
+        llvm::StringSet<> Next = Exit;
+        merge(Next, Live);
+        Live = Next;
+        use(Cond);
+        if (sameSet(Live, Head))
+          break;
+        Head = Live;
+      }
+      Rewrite = SavedRewrite;
+      Heads[Loop] = Head;
+      return Head;
+    }
+
+  public:
+    DeadCodeVisitor(llvm::ArrayRef<std::string> Outputs)
+    {
+      for (const std::string &Name : Outputs)
+      {
+        Live.insert(Name);
+        Referenced.insert(Name);
+      }
+    }
+
+    virtual void visit(Program &Node) override
+    {
+      Node.setdata(optimizeBody(Node.begin(), Node.end()));
+    };
+
+    virtual void visit(DeclarationInt &Node) override
+    {
+      // every initializer is evaluated before any of the variables is stored
+      llvm::SmallVector<llvm::StringRef> Vars;
+      llvm::SmallVector<Expr *> Values;
+      llvm::SmallVector<Expr *>::const_iterator V = Node.valBegin();
+      for (llvm::SmallVector<llvm::StringRef>::const_iterator I = Node.varBegin(), E = Node.varEnd(); I != E; ++I, ++V)
+      {
+        bool Pure = !hasSideEffect(*V);
+        if (Live.count(*I) || !Pure)
+        {
+          Vars.push_back(*I);
+          Values.push_back(*V);
+        }
+        else if (Referenced.count(*I) && !(Rewrite && sink(*I, false)))
+        {
+          // the variable is used later but not this value: keep it with the default value
+          Vars.push_back(*I);
+          Values.push_back(new Final(Final::Number, llvm::StringRef("0")));
+        }
+        Sinkable.erase(*I);
+      }
+      for (llvm::StringRef Var : Vars)
+        Live.erase(Var);
+      for (Expr *E : Values)
+        use(E);
+      if (Vars.empty())
+        return;
+      if (Rewrite)
+      {
+        Node.setVars(Vars);
+        Node.setValues(Values);
+      }
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(DeclarationBool &Node) override
+    {
+      llvm::SmallVector<llvm::StringRef> Vars;
+      llvm::SmallVector<Logic *> Values;
+      llvm::SmallVector<Logic *>::const_iterator V = Node.valBegin();
+      for (llvm::SmallVector<llvm::StringRef>::const_iterator I = Node.varBegin(), E = Node.varEnd(); I != E; ++I, ++V)
+      {
+        bool Pure = !hasSideEffect(*V);
+        if (Live.count(*I) || !Pure)
+        {
+          Vars.push_back(*I);
+          Values.push_back(*V);
+        }
+        else if (Referenced.count(*I) && !(Rewrite && sink(*I, true)))
+        {
+          Vars.push_back(*I);
+          Values.push_back(new Comparison(nullptr, nullptr, Comparison::False));
+        }
+        Sinkable.erase(*I);
+      }
+      for (llvm::StringRef Var : Vars)
+        Live.erase(Var);
+      for (Logic *L : Values)
+        use(L);
+      if (Vars.empty())
+        return;
+      if (Rewrite)
+      {
+        Node.setVars(Vars);
+        Node.setValues(Values);
+      }
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(Assignment &Node) override
+    {
+      llvm::StringRef Name = Node.getLeft()->getVal();
+      AST *Right = Node.getRightExpr() ? (AST *)Node.getRightExpr() : (AST *)Node.getRightLogic();
+      if (!Live.count(Name) && !hasSideEffect(Right))
+        return;
+      bool Plain = Node.getAssignKind() == Assignment::Assign && !reads(Right, Name);
+      keepAssignment(Node);
+      if (Rewrite && Plain)
+        Sinkable[Name] = SinkTarget{List, Out.size(), &Node};
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(Final &Node) override {};
+
+    virtual void visit(BinaryOp &Node) override {};
+
+    // only reached for x++; on its own, expressions go through ReadVars
+    virtual void visit(UnaryOp &Node) override
+    {
+      if (!Live.count(Node.getIdent()))
+        return;
+      reference(Node.getIdent());
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(SignedNumber &Node) override {};
+
+    virtual void visit(NegExpr &Node) override {};
+
+    virtual void visit(Comparison &Node) override {};
+
+    virtual void visit(LogicalExpr &Node) override {};
+
+    virtual void visit(PrintStmt &Node) override
+    {
+      Live.insert(Node.getVar());
+      reference(Node.getVar());
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(IfStmt &Node) override
+    {
+      llvm::StringSet<> Exit = Live;
+      llvm::StringSet<> Entry;
+      bool Empty = true;
+
+      Live = Exit;
+      llvm::SmallVector<AST *> IfBody = optimizeBody(Node.begin(), Node.end());
+      Empty &= IfBody.empty();
+      merge(Entry, Live);
+
+      for (llvm::SmallVector<elifStmt *>::const_iterator I = Node.beginElif(), E = Node.endElif(); I != E; ++I)
+      {
+        Live = Exit;
+        llvm::SmallVector<AST *> Body = optimizeBody((*I)->begin(), (*I)->end());
+        Empty &= Body.empty();
+        merge(Entry, Live);
+        if (Rewrite)
+          (*I)->setBody(Body);
+      }
+
+      // without an else branch the program can fall through with the exit state
+      Live = Exit;
+      llvm::SmallVector<AST *> ElseBody = optimizeBody(Node.beginElse(), Node.endElse());
+      Empty &= ElseBody.empty();
+      merge(Entry, Live);
+
+      Live = Entry;
+      bool SideEffect = hasSideEffect(Node.getCond());
+      for (llvm::SmallVector<elifStmt *>::const_iterator I = Node.beginElif(), E = Node.endElif(); I != E; ++I)
+        SideEffect |= hasSideEffect((*I)->getCond());
+      if (Empty && !SideEffect)
+      {
+        // nothing any arm does is observable
+        Live = Exit;
+        return;
+      }
+      use(Node.getCond());
+      for (llvm::SmallVector<elifStmt *>::const_iterator I = Node.beginElif(), E = Node.endElif(); I != E; ++I)
+        use((*I)->getCond());
+      if (Rewrite)
+      {
+        Node.setBody(IfBody);
+        Node.setElse(ElseBody);
+      }
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(elifStmt &Node) override {};
+
+    virtual void visit(WhileStmt &Node) override
+    {
+      // the loop stays: whether it terminates is observable
+      llvm::StringSet<> Exit = Live;
+      llvm::StringSet<> Head = loopHead(&Node, Node.getCond(), Exit, [&]() { optimizeBody(Node.begin(), Node.end()); });
+      if (Rewrite)
+      {
+        Live = Head;
+        Node.setBody(optimizeBody(Node.begin(), Node.end()));
+      }
+      Live = Head;
+      use(Node.getCond());
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(ForStmt &Node) override
+    {
+      // for (First; Second; Third) Body runs as First; while (Second) { Body; Third }
+      // the header is always kept, so the step is treated as a use of its variable
+      auto Step = [&]() {
+        if (Node.getThirdAssign())
+        {
+          keepAssignment(*Node.getThirdAssign());
+          Live.insert(Node.getThirdAssign()->getLeft()->getVal());
+        }
+        else
+        {
+          Live.insert(Node.getThirdUnary()->getIdent());
+          reference(Node.getThirdUnary()->getIdent());
+        }
+      };
+      llvm::StringSet<> Exit = Live;
+      llvm::StringSet<> Head = loopHead(&Node, Node.getSecond(), Exit, [&]() {
+        Step();
+        optimizeBody(Node.begin(), Node.end());
+      });
+      if (Rewrite)
+      {
+        Live = Head;
+        Step();
+        Node.setBody(optimizeBody(Node.begin(), Node.end()));
+      }
+      Live = Head;
+      use(Node.getSecond());
+      keepAssignment(*Node.getFirst());
+      Out.push_back(&Node);
+    };
+  };
+}
+
+void DeadCodeElim::optimize(Program *Tree, llvm::ArrayRef<std::string> Outputs)
+{
+  if (!Tree)
+    return;
+  dce::DeadCodeVisitor Eliminator(Outputs);
+  Tree->accept(Eliminator);
+}
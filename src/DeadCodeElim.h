@@ -0,0 +1,33 @@
+#ifndef DEADCODEELIM_H
+#define DEADCODEELIM_H
+
+#include "AST.h"
+#include "ASTPass.h"
+#include "llvm/ADT/ArrayRef.h"
+#include <string>
+#include <vector>
+
+// Liveness-based dead code elimination over the AST.
+// The roots are print statements, loop conditions and the values the
+// output variables hold at the end of the program. Assignments and
+// declarations whose value can not reach a root are removed. A declaration
+// whose value is overwritten before any use moves to the assignment that
+// overwrites it.
+class DeadCodeElim : public ASTPass
+{
+  std::vector<std::string> Outputs;
+
+public:
+  DeadCodeElim() {}
+  // The outputs used when the pass is run as a visitor
+  DeadCodeElim(llvm::ArrayRef<std::string> Outputs) : Outputs(Outputs.begin(), Outputs.end()) {}
+
+  void optimize(Program *Tree, llvm::ArrayRef<std::string> Outputs);
+
+  virtual void visit(Program &Node) override
+  {
+    optimize(&Node, Outputs);
+  };
+};
+
+#endif
@@ -0,0 +1,263 @@
+#include "Evaluator.h"
+#include "ConstantFolder.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include <cstdint>
+
+namespace ev{
+
+  // Executes the statements with the semantics of the IR CodeGen emits:
+  // the values of a declaration are computed before any of its variables
+  // is stored, both sides of and/or are evaluated and x++ gives the new value.
+  class EvalVisitor : public ASTVisitor
+  {
+    llvm::StringMap<int> Vars;      // every variable whose declaration was executed
+    llvm::StringSet<> BoolVars;     // those declared as bool
+    llvm::SmallVectorImpl<PrintedValue> &Prints;
+    uint64_t MaxSteps, MaxMemory;
+    int Value;                      // value of the last visited expression or condition
+
+  public:
+    uint64_t Steps = 0;
+    uint64_t Memory = 0;
+    Evaluator::Outcome Result = Evaluator::Finished;
+
+    EvalVisitor(llvm::SmallVectorImpl<PrintedValue> &Prints, uint64_t MaxSteps, uint64_t MaxMemory)
+        : Prints(Prints), MaxSteps(MaxSteps), MaxMemory(MaxMemory) {}
+
+  private:
+    bool stopped()
+    {
+      return Result != Evaluator::Finished;
+    }
+
+    void stop(Evaluator::Outcome Why)
+    {
+      if (!stopped())
+        Result = Why;
+    }
+
+    // Counts one step, false once the evaluation has stopped
+    bool step()
+    {
+      if (++Steps > MaxSteps)
+        stop(Evaluator::OutOfSteps);
+      return !stopped();
+    }
+
+    void allocate(uint64_t Bytes)
+    {
+      Memory += Bytes;
+      if (Memory > MaxMemory)
+        stop(Evaluator::OutOfMemory);
+    }
+
+    int eval(AST *Node)
+    {
+      Value = 0;
+      if (step())
+        Node->accept(*this);
+      return Value;
+    }
+
+    int load(llvm::StringRef Name)
+    {
+      llvm::StringMap<int>::const_iterator I = Vars.find(Name);
+      if (I == Vars.end())
+      {
+        stop(Evaluator::Undefined);
+        return 0;
+      }
+      return I->second;
+    }
+
+    void store(llvm::StringRef Name, int Val)
+    {
+      std::pair<llvm::StringMap<int>::iterator, bool> It = Vars.try_emplace(Name, Val);
+      if (It.second)
+        allocate(Name.size() + sizeof(int));
+      else
+        It.first->second = Val;
+    }
+
+    // Stops unless a folder could compute the value
+    void defined(bool Folded)
+    {
+      if (!Folded)
+        stop(Evaluator::Undefined);
+    }
+
+    template <typename Iterator>
+    void all(Iterator Begin, Iterator End)
+    {
+      for (Iterator I = Begin; I != End && step(); ++I)
+        (*I)->accept(*this);
+    }
+
+    template <typename Decl>
+    void declare(Decl &Node, bool IsBool)
+    {
+      llvm::SmallVector<int, 8> Values;
+      auto Val = Node.valBegin();
+      for (auto Var = Node.varBegin(), End = Node.varEnd(); Var != End; ++Var, ++Val)
+        Values.push_back(Val < Node.valEnd() && *Val ? eval(*Val) : 0);
+      unsigned I = 0;
+      for (auto Var = Node.varBegin(), End = Node.varEnd(); Var != End; ++Var)
+      {
+        store(*Var, Values[I++]);
+        if (IsBool)
+          BoolVars.insert(*Var);
+      }
+    }
+
+  public:
+    virtual void visit(Program &Node) override
+    {
+      all(Node.begin(), Node.end());
+    };
+
+    virtual void visit(DeclarationInt &Node) override
+    {
+      declare(Node, false);
+    };
+
+    virtual void visit(DeclarationBool &Node) override
+    {
+      declare(Node, true);
+    };
+
+    virtual void visit(Assignment &Node) override
+    {
+      llvm::StringRef Name = Node.getLeft()->getVal();
+      int Old = Node.getAssignKind() == Assignment::Assign ? 0 : load(Name);
+      int Right = Node.getRightExpr() ? eval(Node.getRightExpr()) : eval(Node.getRightLogic());
+      defined(ConstantFolder::assign(Node.getAssignKind(), Old, Right, Value));
+      store(Name, Value);
+    };
+
+    virtual void visit(Final &Node) override
+    {
+      if (Node.getKind() == Final::Ident)
+        Value = load(Node.getVal());
+      else
+        defined(ConstantFolder::number(Node.getVal(), Value));
+    };
+
+    virtual void visit(BinaryOp &Node) override
+    {
+      int Left = eval(Node.getLeft());
+      int Right = eval(Node.getRight());
+      defined(ConstantFolder::binary(Node.getOperator(), Left, Right, Value, Node.wraps()));
+    };
+
+    virtual void visit(UnaryOp &Node) override
+    {
+      defined(ConstantFolder::unary(Node.getOperator(), load(Node.getIdent()), Value));
+      store(Node.getIdent(), Value);
+    };
+
+    virtual void visit(SignedNumber &Node) override
+    {
+      defined(ConstantFolder::signedNumber(Node.getSign(), Node.getValue(), Value));
+    };
+
+    virtual void visit(NegExpr &Node) override
+    {
+      Value = ConstantFolder::neg(eval(Node.getExpr()));
+    };
+
+    virtual void visit(Comparison &Node) override
+    {
+      switch (Node.getOperator())
+      {
+      case Comparison::True:
+      case Comparison::False:
+        Value = Node.getOperator() == Comparison::True;
+        return;
+      case Comparison::Ident:
+        Value = eval(Node.getLeft());
+        return;
+      default:
+        break;
+      }
+      int Left = eval(Node.getLeft());
+      int Right = eval(Node.getRight());
+      Value = ConstantFolder::comparison(Node.getOperator(), Left, Right);
+    };
+
+    virtual void visit(LogicalExpr &Node) override
+    {
+      int Left = eval(Node.getLeft());
+      if (!Node.getRight())
+      {
+        Value = Left;
+        return;
+      }
+      int Right = eval(Node.getRight());
+      Value = ConstantFolder::logical(Node.getOperator(), Left, Right);
+    };
+
+    virtual void visit(IfStmt &Node) override
+    {
+      if (eval(Node.getCond()))
+      {
+        all(Node.begin(), Node.end());
+        return;
+      }
+      for (llvm::SmallVector<elifStmt *, 8>::const_iterator I = Node.beginElif(), E = Node.endElif(); I != E; ++I)
+        if (!stopped() && eval((*I)->getCond()))
+        {
+          all((*I)->begin(), (*I)->end());
+          return;
+        }
+      all(Node.beginElse(), Node.endElse());
+    };
+
+    virtual void visit(elifStmt &Node) override {};
+
+    virtual void visit(WhileStmt &Node) override
+    {
+      while (eval(Node.getCond()) && !stopped())
+        all(Node.begin(), Node.end());
+    };
+
+    virtual void visit(ForStmt &Node) override
+    {
+      Node.getFirst()->accept(*this);
+      while (eval(Node.getSecond()) && !stopped())
+      {
+        all(Node.begin(), Node.end());
+        if (Node.getThirdAssign())
+          eval(Node.getThirdAssign());
+        else
+          eval(Node.getThirdUnary());
+      }
+    };
+
+    virtual void visit(PrintStmt &Node) override
+    {
+      int Val = load(Node.getVar());
+      if (stopped())
+        return;
+      Prints.push_back({Val, BoolVars.count(Node.getVar()) != 0});
+      allocate(sizeof(PrintedValue));
+    };
+  };
+}
+
+Evaluator::Outcome Evaluator::run(Program *Tree, llvm::SmallVectorImpl<PrintedValue> &Prints)
+{
+  ev::EvalVisitor Eval(Prints, MaxSteps, MaxMemory);
+  Tree->accept(Eval);
+  Steps = Eval.Steps;
+  Memory = Eval.Memory;
+  Result = Eval.Result;
+  return Result;
+}
+
+void Evaluator::report(llvm::raw_ostream &OS)
+{
+  static const char *const Outcomes[] = {"finished", "step budget exhausted", "memory budget exhausted",
+                                         "undefined behaviour"};
+  OS << "evaluation: " << Outcomes[Result] << " after " << Steps << " steps, " << Memory << " bytes\n";
+}
@@ -0,0 +1,51 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include "AST.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+
+// A value the program prints
+struct PrintedValue
+{
+  int Value;
+  bool IsBool;
+};
+
+// Runs a whole program at compile time.
+// Programs read no input, so one that finishes prints the same values on
+// every run and CodeGen only has to emit those prints. The evaluation
+// gives up when it takes more steps (statements, loop tests and
+// expression nodes) or keeps more bytes of printed values and variables
+// than its budget, and on everything the IR leaves undefined: signed
+// overflow of + - * and ++ --, division by zero and reads of variables
+// whose declaration was not executed. The program is compiled as usual then.
+class Evaluator
+{
+public:
+  enum Outcome
+  {
+    Finished,
+    OutOfSteps,
+    OutOfMemory,
+    Undefined
+  };
+
+private:
+  uint64_t MaxSteps;
+  uint64_t MaxMemory;
+  uint64_t Steps = 0;               // used by the last run
+  uint64_t Memory = 0;
+  Outcome Result = Finished;
+
+public:
+  Evaluator(uint64_t MaxSteps, uint64_t MaxMemory) : MaxSteps(MaxSteps), MaxMemory(MaxMemory) {}
+
+  // The values are only complete if the outcome is Finished
+  Outcome run(Program *Tree, llvm::SmallVectorImpl<PrintedValue> &Prints);
+
+  void report(llvm::raw_ostream &OS);
+};
+
+#endif
@@ -77,134 +77,56 @@ void Lexer::next(Token &token) {
         formToken(token, end, Token::number);
         return;
     } else if (charinfo::isSpecialCharacter(*BufferPtr)) {
-        const char *endWithOneLetter = BufferPtr + 1;
-        const char *endWithTwoLetter = BufferPtr + 2;
-        const char *end;
-        llvm::StringRef NameWithOneLetter(BufferPtr, endWithOneLetter - BufferPtr);
-        llvm::StringRef NameWithTwoLetter(BufferPtr, endWithTwoLetter - BufferPtr);
+        // the first character picks the token, the second one only tells the
+        // one-character operator from the two-character one
+        char second = BufferPtr[1];
         Token::TokenKind kind;
-        bool isFound = false;
-        if (NameWithTwoLetter == "=="){
-            kind = Token::eq;
-            isFound = true;
-            end = endWithTwoLetter;
-        } else if (NameWithOneLetter == "=") {
-            kind = Token::assign;
-            isFound = true;
-            end = endWithOneLetter;
-        } else if (NameWithTwoLetter == "!="){
-            kind = Token::neq;
-            isFound = true;
-            end = endWithTwoLetter;
-        } else if (NameWithTwoLetter == "-("){
-            kind = Token::minus_paren;
-            isFound = true;
-            end = endWithTwoLetter;
-        }else if (NameWithTwoLetter == "+="){
-            kind = Token::plus_assign;
-            isFound = true;
-            end = endWithTwoLetter;
-        } else if (NameWithTwoLetter == "-="){
-            kind = Token::minus_assign;
-            isFound = true;
-            end = endWithTwoLetter;
-        } else if (NameWithTwoLetter == "*="){
-            kind = Token::star_assign;
-            isFound = true;
-            end = endWithTwoLetter;
-        } else if (NameWithTwoLetter == "*/"){
-            kind = Token::end_comment;
-            isFound = true;
-            end = endWithTwoLetter;
-        } else if (NameWithTwoLetter == "/="){
-            kind = Token::slash_assign;
-            isFound = true;
-            end = endWithTwoLetter;
-        } else if (NameWithTwoLetter == "/*"){
-            kind = Token::start_comment;
-            isFound = true;
-            end = endWithTwoLetter;
-        } else if (NameWithTwoLetter == ">="){
-            kind = Token::gte;
-            isFound = true;
-            end = endWithTwoLetter;
-        } else if (NameWithTwoLetter == "<="){
-            kind = Token::lte;
-            isFound = true;
-            end = endWithTwoLetter;
-        } else if (NameWithTwoLetter == "++"){
-            kind = Token::plus_plus;
-            isFound = true;
-            end = endWithTwoLetter;
-        } else if (NameWithTwoLetter == "--"){
-            kind = Token::minus_minus;
-            isFound = true;
-            end = endWithTwoLetter;
-        } else if (NameWithOneLetter == "+"){
-            kind = Token::plus;
-            isFound = true;
-            end = endWithOneLetter;
-        } else if (NameWithOneLetter == "-"){
-            kind = Token::minus;
-            isFound = true;
-            end = endWithOneLetter;
-        } else if (NameWithOneLetter == "*"){
-            kind = Token::star;
-            isFound = true;
-            end = endWithOneLetter;
-        } else if (NameWithOneLetter == "/"){
-            kind = Token::slash;
-            isFound = true;
-            end = endWithOneLetter;
-        } else if (NameWithOneLetter == "+"){
-            kind = Token::plus;
-            isFound = true;
-            end = endWithOneLetter;
-        } else if (NameWithOneLetter == ">"){
-            kind = Token::gt;
-            isFound = true;
-            end = endWithOneLetter;
-        } else if (NameWithOneLetter == "<"){
-            kind = Token::lt;
-            isFound = true;
-            end = endWithOneLetter;
-        } else if (NameWithOneLetter == "("){
-            kind = Token::l_paren;
-            isFound = true;
-            end = endWithOneLetter;
-        } else if (NameWithOneLetter == ")"){
-            kind = Token::r_paren;
-            isFound = true;
-            end = endWithOneLetter;
-        } else if (NameWithOneLetter == "{"){
-            kind = Token::l_brace;
-            isFound = true;
-            end = endWithOneLetter;
-        } else if (NameWithOneLetter == "}"){
-            kind = Token::r_brace;
-            isFound = true;
-            end = endWithOneLetter;
-        } else if (NameWithOneLetter == ";"){
-            kind = Token::semicolon;
-            isFound = true;
-            end = endWithOneLetter;
-        } else if (NameWithOneLetter == ","){
-            kind = Token::comma;
-            isFound = true;
-            end = endWithOneLetter;
-        } else if (NameWithOneLetter == "%"){
-            kind = Token::mod;
-            isFound = true;
-            end = endWithOneLetter;
-        } else if (NameWithOneLetter == "^"){
-            kind = Token::exp;
-            isFound = true;
-            end = endWithOneLetter;
+        bool twoLetters = false;
+        switch (*BufferPtr) {
+        case '=':
+            twoLetters = second == '=';
+            kind = twoLetters ? Token::eq : Token::assign;
+            break;
+        case '!':
+            twoLetters = second == '=';
+            kind = twoLetters ? Token::neq : Token::unknown;
+            break;
+        case '-':
+            twoLetters = second == '(' || second == '=' || second == '-';
+            kind = second == '(' ? Token::minus_paren : second == '=' ? Token::minus_assign : second == '-' ? Token::minus_minus : Token::minus;
+            break;
+        case '+':
+            twoLetters = second == '=' || second == '+';
+            kind = second == '=' ? Token::plus_assign : second == '+' ? Token::plus_plus : Token::plus;
+            break;
+        case '*':
+            twoLetters = second == '=' || second == '/';
+            kind = second == '=' ? Token::star_assign : second == '/' ? Token::end_comment : Token::star;
+            break;
+        case '/':
+            twoLetters = second == '=' || second == '*';
+            kind = second == '=' ? Token::slash_assign : second == '*' ? Token::start_comment : Token::slash;
+            break;
+        case '>':
+            twoLetters = second == '=';
+            kind = twoLetters ? Token::gte : Token::gt;
+            break;
+        case '<':
+            twoLetters = second == '=';
+            kind = twoLetters ? Token::lte : Token::lt;
+            break;
+        case '(': kind = Token::l_paren; break;
+        case ')': kind = Token::r_paren; break;
+        case '{': kind = Token::l_brace; break;
+        case '}': kind = Token::r_brace; break;
+        case ';': kind = Token::semicolon; break;
+        case ',': kind = Token::comma; break;
+        case '%': kind = Token::mod; break;
+        default: kind = Token::exp; break; // '^'
         }
-        
+
         // generate the token
-        if (isFound) formToken(token, end, kind);
-        else formToken(token, BufferPtr + 1, Token::unknown);
+        formToken(token, BufferPtr + (twoLetters ? 2 : 1), kind);
         return;
     } else {
         formToken(token, BufferPtr + 1, Token::unknown); 
@@ -0,0 +1,279 @@
+#include "LoopFusion.h"
+#include "ASTShape.h"
+#include "AssignedVars.h"
+#include "StmtRewriter.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/Format.h"
+
+namespace fuse{
+
+  // The variables statements read and assign, and whether they print or loop
+  class Effects : public ASTVisitor
+  {
+    template <typename Iterator>
+    void all(Iterator Begin, Iterator End)
+    {
+      for (Iterator I = Begin; I != End; ++I)
+        if (*I)
+          (*I)->accept(*this);
+    }
+
+  public:
+    llvm::StringSet<> Reads, Writes;
+    bool Prints = false;
+    bool Loops = false;
+
+    void add(AST *Node)
+    {
+      AssignedVars Collector(Writes);
+      Node->accept(Collector);
+      Node->accept(*this);
+    }
+
+    virtual void visit(Final &Node) override
+    {
+      if (Node.getKind() == Final::Ident)
+        Reads.insert(Node.getVal());
+    };
+
+    virtual void visit(BinaryOp &Node) override
+    {
+      Node.getLeft()->accept(*this);
+      Node.getRight()->accept(*this);
+    };
+
+    virtual void visit(UnaryOp &Node) override
+    {
+      Reads.insert(Node.getIdent());
+    };
+
+    virtual void visit(SignedNumber &Node) override {};
+
+    virtual void visit(NegExpr &Node) override
+    {
+      Node.getExpr()->accept(*this);
+    };
+
+    virtual void visit(Assignment &Node) override
+    {
+      if (Node.getAssignKind() != Assignment::Assign)
+        Reads.insert(Node.getLeft()->getVal());
+      if (Node.getRightExpr())
+        Node.getRightExpr()->accept(*this);
+      else
+        Node.getRightLogic()->accept(*this);
+    };
+
+    virtual void visit(DeclarationInt &Node) override
+    {
+      all(Node.valBegin(), Node.valEnd());
+    };
+
+    virtual void visit(DeclarationBool &Node) override
+    {
+      all(Node.valBegin(), Node.valEnd());
+    };
+
+    virtual void visit(Comparison &Node) override
+    {
+      if (Node.getLeft())
+        Node.getLeft()->accept(*this);
+      if (Node.getRight())
+        Node.getRight()->accept(*this);
+    };
+
+    virtual void visit(LogicalExpr &Node) override
+    {
+      if (Node.getLeft())
+        Node.getLeft()->accept(*this);
+      if (Node.getRight())
+        Node.getRight()->accept(*this);
+    };
+
+    virtual void visit(IfStmt &Node) override
+    {
+      Node.getCond()->accept(*this);
+      all(Node.begin(), Node.end());
+      all(Node.beginElif(), Node.endElif());
+      all(Node.beginElse(), Node.endElse());
+    };
+
+    virtual void visit(elifStmt &Node) override
+    {
+      Node.getCond()->accept(*this);
+      all(Node.begin(), Node.end());
+    };
+
+    virtual void visit(WhileStmt &Node) override
+    {
+      Loops = true;
+      Node.getCond()->accept(*this);
+      all(Node.begin(), Node.end());
+    };
+
+    virtual void visit(ForStmt &Node) override
+    {
+      Loops = true;
+      Node.getFirst()->accept(*this);
+      Node.getSecond()->accept(*this);
+      if (Node.getThirdAssign())
+        Node.getThirdAssign()->accept(*this);
+      else
+        Node.getThirdUnary()->accept(*this);
+      all(Node.begin(), Node.end());
+    };
+
+    virtual void visit(PrintStmt &Node) override
+    {
+      Prints = true;
+      Reads.insert(Node.getVar());
+    };
+  };
+
+  bool overlap(const llvm::StringSet<> &A, const llvm::StringSet<> &B)
+  {
+    for (const auto &Var : A)
+      if (B.count(Var.getKey()))
+        return true;
+    return false;
+  }
+
+  // A loop as its counter reset, condition, counter step and the rest of its body
+  struct Loop
+  {
+    Assignment *Init;
+    Logic *Cond;
+    AST *Step;
+    llvm::SmallVector<AST *> Body;
+  };
+
+  // The variable a counter step assigns, empty if it is no ++, --, += or -=
+  llvm::StringRef stepped(AST *Step)
+  {
+    Shape S(Step);
+    if (S.Unary)
+      return S.Unary->getIdent();
+    if (S.Assign && S.Assign->getRightExpr() &&
+        (S.Assign->getAssignKind() == Assignment::Plus_assign || S.Assign->getAssignKind() == Assignment::Minus_assign))
+      return S.Assign->getLeft()->getVal();
+    return "";
+  }
+
+  // Whether B can run in the iterations of A instead of after it
+  bool fusable(Loop &A, Loop &B)
+  {
+    llvm::StringRef Counter = A.Init->getLeft()->getVal();
+    if (A.Init->getAssignKind() != Assignment::Assign || !A.Init->getRightExpr() ||
+        stepped(A.Step) != Counter || !same(A.Init, B.Init) || !same(A.Cond, B.Cond) || !same(A.Step, B.Step))
+      return false;
+
+    // the same iteration space: the start and the condition read nothing
+    // the loops change but the counter, which only the step changes
+    Effects Start, Header, First, Second;
+    Start.add(A.Init->getRightExpr());
+    Header.add(A.Cond);
+    Header.add(A.Step);
+    for (AST *Stmt : A.Body)
+      First.add(Stmt);
+    for (AST *Stmt : B.Body)
+      Second.add(Stmt);
+    if (!Start.Writes.empty() || Start.Reads.count(Counter) || Header.Writes.size() != 1)
+      return false;
+    for (Effects *Body : {&First, &Second})
+      if (Body->Writes.count(Counter) || overlap(Start.Reads, Body->Writes) || overlap(Header.Reads, Body->Writes))
+        return false;
+
+    // no dependence between the bodies, which only share variables they read
+    if (overlap(First.Writes, Second.Reads) || overlap(First.Writes, Second.Writes) ||
+        overlap(Second.Writes, First.Reads))
+      return false;
+    // the prints keep their order even if a body never finishes an iteration
+    return !(First.Prints && (Second.Prints || Second.Loops)) && !(Second.Prints && First.Loops);
+  }
+
+  Loop forLoop(ForStmt &Node)
+  {
+    Loop L;
+    L.Init = Node.getFirst();
+    L.Cond = Node.getSecond();
+    L.Step = Node.getThirdAssign() ? (AST *)Node.getThirdAssign() : (AST *)Node.getThirdUnary();
+    L.Body.assign(Node.begin(), Node.end());
+    return L;
+  }
+
+  // A while loop after the reset of its counter, which ends with the step
+  bool whileLoop(AST *Reset, AST *While, Loop &L)
+  {
+    Shape R(Reset), W(While);
+    if (!R.Assign || !W.While || W.While->begin() == W.While->end())
+      return false;
+    L.Init = R.Assign;
+    L.Cond = W.While->getCond();
+    L.Body.assign(W.While->begin(), W.While->end());
+    L.Step = L.Body.pop_back_val();
+    return true;
+  }
+
+  // Rebuilds every statement list with each loop merged into the loop before
+  // it where possible
+  class FusionVisitor : public StmtRewriter
+  {
+    unsigned &Fused;
+
+  public:
+    FusionVisitor(unsigned &Fused) : Fused(Fused) {}
+
+    virtual void visit(ForStmt &Node) override
+    {
+      Node.setBody(rewrite(Node.begin(), Node.end()));
+      if (!Out.empty())
+      {
+        Shape Prev(Out.back());
+        if (Prev.For)
+        {
+          Loop A = forLoop(*Prev.For), B = forLoop(Node);
+          if (fusable(A, B))
+          {
+            ++Fused;
+            A.Body.append(B.Body.begin(), B.Body.end());
+            Prev.For->setBody(A.Body);
+            return;
+          }
+        }
+      }
+      Out.push_back(&Node);
+    };
+
+    virtual void visit(WhileStmt &Node) override
+    {
+      Node.setBody(rewrite(Node.begin(), Node.end()));
+      size_t N = Out.size();
+      Loop A, B;
+      if (N >= 3 && whileLoop(Out[N - 3], Out[N - 2], A) && whileLoop(Out[N - 1], &Node, B) && fusable(A, B))
+      {
+        ++Fused;
+        A.Body.append(B.Body.begin(), B.Body.end());
+        A.Body.push_back(A.Step);
+        Shape(Out[N - 2]).While->setBody(A.Body);
+        Out.pop_back();             // the second reset
+        return;
+      }
+      Out.push_back(&Node);
+    };
+  };
+}
+
+void LoopFusion::optimize(Program *Tree)
+{
+  if (!Tree)
+    return;
+  Fused = 0;
+  fuse::FusionVisitor Fuser(Fused);
+  Tree->accept(Fuser);
+}
+
+void LoopFusion::report(llvm::raw_ostream &OS)
+{
+  if (Fused)
+    OS << llvm::format("  loops fused        %8u\n", Fused);
+}
@@ -0,0 +1,31 @@
+#ifndef LOOPFUSION_H
+#define LOOPFUSION_H
+
+#include "AST.h"
+#include "ASTPass.h"
+
+// Fusion of adjacent loops over the same iteration space.
+// Two for loops one after the other with the same init, condition and
+// step, or two while loops that each follow the same reset of their
+// counter and end with the same step of it, become one loop running both
+// bodies. The counter and the variables the init and the condition read
+// must not be assigned in the bodies, the second body must not touch a
+// variable the first assigns nor assign one it reads, and prints may not
+// be reordered: only one body may print, and then the other one must
+// contain no loop that might not end.
+class LoopFusion : public ASTPass
+{
+  unsigned Fused = 0;               // loops merged into the loop before them
+
+public:
+  void optimize(Program *Tree);
+
+  virtual void visit(Program &Node) override
+  {
+    optimize(&Node);
+  };
+
+  virtual void report(llvm::raw_ostream &OS) override;
+};
+
+#endif
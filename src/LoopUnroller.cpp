@@ -0,0 +1,206 @@
+#include "LoopUnroller.h"
+#include "ASTCloner.h"
+#include "ASTShape.h"
+#include "AssignedVars.h"
+#include "ConstProp.h"
+#include "ConstantFolder.h"
+#include "NodeCounter.h"
+#include "StmtRewriter.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include <cstdint>
+
+static llvm::cl::opt<unsigned> UnrollFactor("unroll-factor",
+	llvm::cl::desc("Copies of the body in a for loop that is unrolled partially (1 to only unroll fully)"),
+	llvm::cl::init(4));
+
+static llvm::cl::opt<unsigned> UnrollSize("unroll-size",
+	llvm::cl::desc("Nodes the copies of an unrolled for loop body may have"),
+	llvm::cl::init(200));
+
+namespace unr{
+
+  // A for loop whose counter steps from Start by Step for Trips iterations
+  struct CountedLoop
+  {
+    llvm::StringRef Var;
+    int Start;
+    int Step;
+    uint64_t Trips;
+  };
+
+  // Whether the loop runs a number of times known at compile time
+  bool countedLoop(ForStmt &Node, CountedLoop &Loop)
+  {
+    Assignment *Init = Node.getFirst();
+    if (Init->getAssignKind() != Assignment::Assign || !Init->getRightExpr())
+      return false;
+    Shape Start(Init->getRightExpr());
+    if (Start.Kind != Shape::Literal)
+      return false;
+    Loop.Var = Init->getLeft()->getVal();
+    Loop.Start = Start.Value;
+    Loop.Step = stepOf(Node.getThirdAssign() ? (AST *)Node.getThirdAssign() : (AST *)Node.getThirdUnary(), Loop.Var);
+    if (!Loop.Step)
+      return false;
+
+    // i < b or b > i
+    Shape Cond(Node.getSecond());
+    if (Cond.Kind != Shape::Compare)
+      return false;
+    Shape L(Cond.Left), R(Cond.Right);
+    Comparison::Operator Op = Cond.CmpOp;
+    int Bound;
+    if (L.Kind == Shape::Variable && L.Name == Loop.Var && R.Kind == Shape::Literal)
+      Bound = R.Value;
+    else if (R.Kind == Shape::Variable && R.Name == Loop.Var && L.Kind == Shape::Literal)
+    {
+      Bound = L.Value;
+      Op = mirror(Op);
+    }
+    else
+      return false;
+
+    llvm::StringSet<> Assigned;
+    AssignedVars Collector(Assigned);
+    for (llvm::SmallVector<AST *>::const_iterator I = Node.begin(), E = Node.end(); I != E; ++I)
+      (*I)->accept(Collector);
+    if (Assigned.count(Loop.Var))
+      return false;
+
+    // the counter takes the values Start + k * Step until the condition fails
+    int64_t Distance = Loop.Step > 0 ? (int64_t)Bound - Loop.Start : (int64_t)Loop.Start - Bound;
+    int64_t Stride = Loop.Step > 0 ? Loop.Step : -(int64_t)Loop.Step;
+    bool Up = Loop.Step > 0;
+    if (!ConstantFolder::comparison(Op, Loop.Start, Bound))
+      Loop.Trips = 0;
+    else if (Op == Comparison::Equal)
+      Loop.Trips = 1;
+    else if (Op == Comparison::Not_equal)
+    {
+      if (Distance <= 0 || Distance % Stride)
+        return false;
+      Loop.Trips = Distance / Stride;
+    }
+    else if (Up == (Op == Comparison::Less || Op == Comparison::Less_equal))
+    {
+      bool Inclusive = Op == Comparison::Less_equal || Op == Comparison::Greater_equal;
+      Loop.Trips = Inclusive ? Distance / Stride + 1 : (Distance + Stride - 1) / Stride;
+    }
+    else
+      return false;                 // it only stops by overflowing
+
+    // the step after the last iteration is an add nsw as well
+    int64_t End = Loop.Start + (int64_t)Loop.Trips * Loop.Step;
+    return End >= INT32_MIN && End <= INT32_MAX;
+  }
+
+  // Rebuilds every statement list with the for loops in it unrolled,
+  // innermost loops first
+  class UnrollVisitor : public StmtRewriter
+  {
+    unsigned &Full, &Partial;
+    ASTCloner Cloner;
+
+    Assignment *setCounter(llvm::StringRef Var, int64_t Value)
+    {
+      return new Assignment(new Final(Final::Ident, Var), makeNumber((int)Value), Assignment::Assign, nullptr);
+    }
+
+    // Appends a copy of the body, the original nodes for the first one
+    void copyBody(ForStmt &Node, llvm::ArrayRef<AST *> Body, bool First)
+    {
+      if (First)
+        Out.append(Body.begin(), Body.end());
+      else
+        Out.append(Cloner.clone(Body.begin(), Body.end()));
+    }
+
+  public:
+    UnrollVisitor(unsigned &Full, unsigned &Partial) : Full(Full), Partial(Partial) {}
+
+    virtual void visit(ForStmt &Node) override
+    {
+      Node.setBody(rewrite(Node.begin(), Node.end()));
+      CountedLoop Loop;
+      if (!countedLoop(Node, Loop))
+      {
+        Out.push_back(&Node);
+        return;
+      }
+      llvm::SmallVector<AST *> Body(Node.begin(), Node.end());
+      NodeCounter Size;
+      for (AST *Stmt : Body)
+        Stmt->accept(Size);
+      uint64_t Copy = Size.Count + 3; // the body and setting the counter
+
+      if (Loop.Trips * Copy <= UnrollSize)
+      {
+        ++Full;
+        Out.push_back(Node.getFirst());
+        for (uint64_t K = 0; K != Loop.Trips; ++K)
+        {
+          copyBody(Node, Body, K == 0);
+          Out.push_back(setCounter(Loop.Var, Loop.Start + (int64_t)(K + 1) * Loop.Step));
+        }
+        return;
+      }
+
+      unsigned Factor = UnrollFactor;
+      if (Factor < 2 || Loop.Trips < 2 * (uint64_t)Factor || Copy * Factor > UnrollSize)
+      {
+        Out.push_back(&Node);
+        return;
+      }
+      // Factor copies per test of the condition, which now stops after the
+      // last full round; the iterations left over follow the loop
+      ++Partial;
+      uint64_t Rounds = Loop.Trips / Factor;
+      int64_t End = Loop.Start + (int64_t)(Rounds * Factor) * Loop.Step;
+      Node.setSecond(new Comparison(new Final(Final::Ident, Loop.Var), makeNumber((int)End),
+                                    Loop.Step > 0 ? Comparison::Less : Comparison::Greater));
+      AST *Step = Node.getThirdAssign() ? (AST *)Node.getThirdAssign() : (AST *)Node.getThirdUnary();
+      llvm::SmallVector<AST *> Outer;
+      std::swap(Outer, Out);
+      for (unsigned K = 0; K != Factor; ++K)
+      {
+        if (K)
+          Out.push_back(Cloner.clone(Step));
+        copyBody(Node, Body, K == 0);
+      }
+      std::swap(Outer, Out);
+      Node.setBody(Outer);
+      Out.push_back(&Node);
+      if (Rounds * Factor != Loop.Trips)
+        Out.push_back(setCounter(Loop.Var, End));
+      for (uint64_t K = Rounds * Factor; K != Loop.Trips; ++K)
+      {
+        copyBody(Node, Body, false);
+        Out.push_back(setCounter(Loop.Var, Loop.Start + (int64_t)(K + 1) * Loop.Step));
+      }
+    };
+  };
+}
+
+void LoopUnroller::optimize(Program *Tree)
+{
+  if (!Tree)
+    return;
+  Full = Partial = 0;
+  unr::UnrollVisitor Unroller(Full, Partial);
+  Tree->accept(Unroller);
+  // folds each copy of a body with its value of the counter
+  if (Full || Partial)
+  {
+    ConstProp Folder;
+    Folder.optimize(Tree);
+  }
+}
+
+void LoopUnroller::report(llvm::raw_ostream &OS)
+{
+  if (Full)
+    OS << llvm::format("  fully unrolled     %8u\n", Full);
+  if (Partial)
+    OS << llvm::format("  partially unrolled %8u (by %u)\n", Partial, (unsigned)UnrollFactor);
+}
@@ -0,0 +1,31 @@
+#ifndef LOOPUNROLLER_H
+#define LOOPUNROLLER_H
+
+#include "AST.h"
+#include "ASTPass.h"
+
+// Unrolling of for loops with a trip count known at compile time.
+// A loop for (i = a; i < b; i += c) with literal a, b and c whose body
+// does not assign i runs a known number of times. If the copies of the
+// body fit in -unroll-size nodes the loop is replaced by them, with
+// i = a + k * c between the copies; otherwise the body is repeated
+// -unroll-factor times inside the loop and the iterations left over run
+// after it. Constant propagation runs again over the unrolled program,
+// so every copy is folded with its own value of i.
+class LoopUnroller : public ASTPass
+{
+  unsigned Full = 0;                // loops replaced by copies of their body
+  unsigned Partial = 0;             // loops with several copies of their body
+
+public:
+  void optimize(Program *Tree);
+
+  virtual void visit(Program &Node) override
+  {
+    optimize(&Node);
+  };
+
+  virtual void report(llvm::raw_ostream &OS) override;
+};
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef NODECOUNTER_H
+#define NODECOUNTER_H
+
+#include "AST.h"
+#include "llvm/ADT/DenseSet.h"
+
+// Counts the distinct nodes of a tree, a node shared by several parents once.
+// It is the size measure of -report-passes and of the unroller's budget.
+class NodeCounter : public ASTVisitor
+{
+  llvm::DenseSet<AST *> Seen;
+
+  // Counts a node and returns false if it was counted already
+  bool count(AST &Node)
+  {
+    if (!Seen.insert(&Node).second)
+      return false;
+    ++Count;
+    return true;
+  }
+
+  template <typename Iterator>
+  void all(Iterator Begin, Iterator End)
+  {
+    for (Iterator I = Begin; I != End; ++I)
+      if (*I)
+        (*I)->accept(*this);
+  }
+
+public:
+  unsigned Count = 0;
+
+  virtual void visit(Program &Node) override
+  {
+    if (!count(Node))
+      return;
+    all(Node.begin(), Node.end());
+  };
+
+  virtual void visit(DeclarationInt &Node) override
+  {
+    if (!count(Node))
+      return;
+    all(Node.valBegin(), Node.valEnd());
+  };
+
+  virtual void visit(DeclarationBool &Node) override
+  {
+    if (!count(Node))
+      return;
+    all(Node.valBegin(), Node.valEnd());
+  };
+
+  virtual void visit(Final &Node) override
+  {
+    if (!count(Node))
+      return;
+  };
+
+  virtual void visit(BinaryOp &Node) override
+  {
+    if (!count(Node))
+      return;
+    Node.getLeft()->accept(*this);
+    Node.getRight()->accept(*this);
+  };
+
+  virtual void visit(UnaryOp &Node) override
+  {
+    if (!count(Node))
+      return;
+  };
+
+  virtual void visit(SignedNumber &Node) override
+  {
+    if (!count(Node))
+      return;
+  };
+
+  virtual void visit(NegExpr &Node) override
+  {
+    if (!count(Node))
+      return;
+    Node.getExpr()->accept(*this);
+  };
+
+  virtual void visit(Assignment &Node) override
+  {
+    if (!count(Node))
+      return;
+    Node.getLeft()->accept(*this);
+    if (Node.getRightExpr())
+      Node.getRightExpr()->accept(*this);
+    if (Node.getRightLogic())
+      Node.getRightLogic()->accept(*this);
+  };
+
+  virtual void visit(Comparison &Node) override
+  {
+    if (!count(Node))
+      return;
+    if (Node.getLeft())
+      Node.getLeft()->accept(*this);
+    if (Node.getRight())
+      Node.getRight()->accept(*this);
+  };
+
+  virtual void visit(LogicalExpr &Node) override
+  {
+    if (!count(Node))
+      return;
+    if (Node.getLeft())
+      Node.getLeft()->accept(*this);
+    if (Node.getRight())
+      Node.getRight()->accept(*this);
+  };
+
+  virtual void visit(IfStmt &Node) override
+  {
+    if (!count(Node))
+      return;
+    Node.getCond()->accept(*this);
+    all(Node.begin(), Node.end());
+    all(Node.beginElif(), Node.endElif());
+    all(Node.beginElse(), Node.endElse());
+  };
+
+  virtual void visit(elifStmt &Node) override
+  {
+    if (!count(Node))
+      return;
+    Node.getCond()->accept(*this);
+    all(Node.begin(), Node.end());
+  };
+
+  virtual void visit(WhileStmt &Node) override
+  {
+    if (!count(Node))
+      return;
+    Node.getCond()->accept(*this);
+    all(Node.begin(), Node.end());
+  };
+
+  virtual void visit(ForStmt &Node) override
+  {
+    if (!count(Node))
+      return;
+    Node.getFirst()->accept(*this);
+    Node.getSecond()->accept(*this);
+    if (Node.getThirdAssign())
+      Node.getThirdAssign()->accept(*this);
+    else
+      Node.getThirdUnary()->accept(*this);
+    all(Node.begin(), Node.end());
+  };
+
+  virtual void visit(PrintStmt &Node) override
+  {
+    if (!count(Node))
+      return;
+  };
+};
+
+#endif
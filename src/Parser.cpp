@@ -70,6 +70,23 @@ Program *Parser::parseProgram()
             prev_token = Tok;
             prev_buffer = Lex.getBuffer();
 
+            // a variable assigned before it is declared is an int declared by that assignment
+            if (!Declared.count(prev_token.getText()))
+            {
+                bool prev_error = HasError;
+                a_int = parseIntAssign();
+                if (a_int && a_int->getAssignKind() == Assignment::Assign && Tok.is(Token::semicolon))
+                {
+                    Declared.insert(prev_token.getText());
+                    data.push_back(new DeclarationInt(llvm::SmallVector<llvm::StringRef>(1, prev_token.getText()),
+                                                      llvm::SmallVector<Expr *>(1, a_int->getRightExpr())));
+                    break;
+                }
+                Tok = prev_token;
+                Lex.setBufferPtr(prev_buffer);
+                HasError = prev_error;
+            }
+
             a_bool = parseBoolAssign();
 
             if (a_bool){
@@ -170,6 +187,7 @@ DeclarationInt *Parser::parseIntDec()
     }
 
     Vars.push_back(Tok.getText());
+    Declared.insert(Tok.getText());
     advance();
 
     if (Tok.is(Token::assign))
@@ -197,6 +215,7 @@ DeclarationInt *Parser::parseIntDec()
         }
             
         Vars.push_back(Tok.getText());
+        Declared.insert(Tok.getText());
         advance();
 
         if(Tok.is(Token::assign)){
@@ -243,6 +262,7 @@ DeclarationBool *Parser::parseBoolDec()
     }
 
     Vars.push_back(Tok.getText());
+    Declared.insert(Tok.getText());
     advance();
 
     if (Tok.is(Token::assign))
@@ -270,6 +290,7 @@ DeclarationBool *Parser::parseBoolDec()
         }
             
         Vars.push_back(Tok.getText());
+        Declared.insert(Tok.getText());
         advance();
 
         if(Tok.is(Token::assign)){
@@ -334,8 +355,7 @@ Assignment *Parser::parseBoolAssign()
     }
     
 _error:
-        while (Tok.getKind() != Token::eoi)
-            advance();
+        // the callers try another rule from the same token, so nothing is skipped
         return nullptr;
     
 }
@@ -385,8 +405,7 @@ Assignment *Parser::parseIntAssign()
     }
 
 _error:
-        while (Tok.getKind() != Token::eoi)
-            advance();
+        // the callers try another rule from the same token, so nothing is skipped
         return nullptr;
 }
 
@@ -417,8 +436,7 @@ UnaryOp *Parser::parseUnary()
     return Res;
 
 _error:
-    while (Tok.getKind() != Token::eoi)
-        advance();
+    // the callers try another rule from the same token, so nothing is skipped
     return nullptr;
 }
 Expr *Parser::parseExpr()
@@ -3,6 +3,7 @@
 
 #include "AST.h"
 #include "Lexer.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/Support/raw_ostream.h"
 
 class Parser
@@ -10,6 +11,7 @@ class Parser
     Lexer &Lex;    // retrieve the next token from the input
     Token Tok;     // stores the next token
     bool HasError; // indicates if an error was detected
+    llvm::StringSet<> Declared; // variables declared so far
 
     void error()
     {
@@ -0,0 +1,117 @@
+#include "PassManager.h"
+#include "AlgebraicSimplifier.h"
+#include "ClosedFormLoops.h"
+#include "CommonSubexprElim.h"
+#include "ConstProp.h"
+#include "CopyProp.h"
+#include "DeadCodeElim.h"
+#include "LoopFusion.h"
+#include "LoopUnroller.h"
+#include "NodeCounter.h"
+#include "Reassociate.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/Format.h"
+#include <chrono>
+
+namespace pm{
+
+  // Every pass the -passes option can name. A new pass is added here.
+  struct PassInfo
+  {
+    const char *Name;
+    const char *Description;
+    bool Last;                      // it leaves a tree the other passes can not take
+    ASTPass *(*Create)(llvm::ArrayRef<std::string> Outputs);
+  };
+
+  const PassInfo Registry[] = {
+    {"constprop", "Flow-sensitive constant propagation and folding", false,
+     [](llvm::ArrayRef<std::string>) -> ASTPass * { return new ConstProp(); }},
+    {"closedform", "Replaces counting loops that only sum affine values by their closed form", false,
+     [](llvm::ArrayRef<std::string>) -> ASTPass * { return new ClosedFormLoops(); }},
+    {"fuse", "Merges adjacent loops over the same iteration space", false,
+     [](llvm::ArrayRef<std::string>) -> ASTPass * { return new LoopFusion(); }},
+    {"unroll", "Unrolls for loops with a trip count known at compile time", false,
+     [](llvm::ArrayRef<std::string>) -> ASTPass * { return new LoopUnroller(); }},
+    {"simplify", "Table-driven algebraic simplification such as x * 1 -> x", false,
+     [](llvm::ArrayRef<std::string>) -> ASTPass * { return new AlgebraicSimplifier(); }},
+    {"reassoc", "Rebuilds long + - * and/or chains as balanced trees", false,
+     [](llvm::ArrayRef<std::string>) -> ASTPass * { return new Reassociate(); }},
+    {"copyprop", "Replaces reads of copies by reads of the copied variables", false,
+     [](llvm::ArrayRef<std::string>) -> ASTPass * { return new CopyProp(); }},
+    {"dce", "Liveness-based dead code elimination", false,
+     [](llvm::ArrayRef<std::string> Outputs) -> ASTPass * { return new DeadCodeElim(Outputs); }},
+    {"cse", "Shares equal subexpressions so CodeGen computes them once (must be last)", true,
+     [](llvm::ArrayRef<std::string>) -> ASTPass * { return new CommonSubexprElim(); }},
+  };
+
+  unsigned countNodes(Program *Tree)
+  {
+    NodeCounter Counter;
+    Tree->accept(Counter);
+    return Counter.Count;
+  }
+}
+
+PassManager::PassManager(llvm::ArrayRef<std::string> Outputs) : Outputs(Outputs.begin(), Outputs.end()) {}
+
+bool PassManager::addPass(llvm::StringRef Name, std::string &Error)
+{
+  for (const pm::PassInfo &Info : pm::Registry)
+    if (Name == Info.Name)
+    {
+      if (!Final.empty())
+      {
+        Error = (llvm::Twine("Pass ") + Name + " can not run after " + Final + ", which has to be the last pass").str();
+        return false;
+      }
+      if (Info.Last)
+        Final = Info.Name;
+      Passes.emplace_back(Info.Name, std::unique_ptr<ASTPass>(Info.Create(Outputs)));
+      return true;
+    }
+  Error = ("Unknown pass: " + Name).str();
+  return false;
+}
+
+void PassManager::run(Program *Tree, bool Report)
+{
+  if (!Tree)
+    return;
+  if (Report)
+  {
+    llvm::errs() << "pass            wall (ms)      nodes\n";
+    llvm::errs() << llvm::format("(input)                   %10u\n", pm::countNodes(Tree));
+  }
+  for (std::pair<std::string, std::unique_ptr<ASTPass>> &Pass : Passes)
+  {
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    Tree->accept(*Pass.second);
+    std::chrono::duration<double, std::milli> Time = std::chrono::steady_clock::now() - Start;
+    if (!Report)
+      continue;
+    llvm::errs() << llvm::format("%-12s %12.3f %10u\n", Pass.first.c_str(), Time.count(), pm::countNodes(Tree));
+    Pass.second->report(llvm::errs());
+  }
+}
+
+void PassManager::printPasses(llvm::raw_ostream &OS)
+{
+  for (const pm::PassInfo &Info : pm::Registry)
+    OS << llvm::format("  %-12s %s\n", Info.Name, Info.Description);
+}
+
+void PassManager::passNames(llvm::SmallVectorImpl<llvm::StringRef> &Names)
+{
+  for (const pm::PassInfo &Info : pm::Registry)
+    Names.push_back(Info.Name);
+}
+
+llvm::ArrayRef<const char *> PassManager::defaultPipeline()
+{
+  // constant propagation first, so the loop passes see literal bounds, and
+  // cse last, because the tree it leaves shares nodes
+  static const char *const Pipeline[] = {"constprop", "closedform", "fuse", "unroll", "simplify",
+                                         "reassoc", "copyprop", "dce", "cse"};
+  return Pipeline;
+}
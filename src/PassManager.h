@@ -0,0 +1,45 @@
+#ifndef PASSMANAGER_H
+#define PASSMANAGER_H
+
+#include "AST.h"
+#include "ASTPass.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Runs a pipeline of registered AST passes in order.
+// With a report, the wall time of every pass and the number of nodes it
+// left in the tree are printed after it, to see what each pass costs and
+// what it removes.
+class PassManager
+{
+  std::vector<std::string> Outputs;
+  std::vector<std::pair<std::string, std::unique_ptr<ASTPass>>> Passes;
+  std::string Final;                // the pass that has to stay last, once added
+
+public:
+  // Outputs are the variables whose final value is observable
+  PassManager(llvm::ArrayRef<std::string> Outputs);
+
+  // Appends the registered pass called Name. Returns false and sets Error if
+  // there is none or if the pipeline already holds a pass that has to be last.
+  bool addPass(llvm::StringRef Name, std::string &Error);
+
+  void run(Program *Tree, bool Report);
+
+  // Lists the registered passes
+  static void printPasses(llvm::raw_ostream &OS);
+
+  // The names of the registered passes, in the order printPasses lists them
+  static void passNames(llvm::SmallVectorImpl<llvm::StringRef> &Names);
+
+  // The pipeline the compiler runs when no other is given
+  static llvm::ArrayRef<const char *> defaultPipeline();
+};
+
+#endif
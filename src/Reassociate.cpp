@@ -0,0 +1,295 @@
+#include "Reassociate.h"
+#include "ASTShape.h"
+#include "ConstantFolder.h"
+#include "llvm/Support/Format.h"
+#include <climits>
+#include <cstdint>
+
+namespace ra{
+
+  // + and * of i32 without overflow flags
+  int wrapAdd(int A, int B)
+  {
+    return (int)((uint32_t)A + (uint32_t)B);
+  }
+
+  int wrapMul(int A, int B)
+  {
+    return (int)((uint32_t)A * (uint32_t)B);
+  }
+
+  // An operand of a sum and whether it is subtracted
+  struct Term
+  {
+    Expr *E;
+    bool Negative;
+  };
+
+  // Rebuilds every chain bottom up. Chains are flattened with a work list
+  // since a long one is as deep as it has operands.
+  class RebalanceVisitor : public ASTVisitor
+  {
+    unsigned &Chains, &Folded, &Longest;
+    Expr *Result;                   // rebuilt form of the last visited expression
+    Logic *LogicResult;             // rebuilt form of the last visited condition
+
+    Expr *rewrite(Expr *E)
+    {
+      E->accept(*this);
+      return Result;
+    }
+
+    Logic *rewrite(Logic *L)
+    {
+      L->accept(*this);
+      return LogicResult;
+    }
+
+    void rebuilt(unsigned Operands)
+    {
+      ++Chains;
+      if (Operands > Longest)
+        Longest = Operands;
+    }
+
+    // The terms as a balanced tree, in their order. A subtracted
+    // first term makes the whole tree subtracted, -a + b is -(a - b).
+    Term build(llvm::ArrayRef<Term> Terms, bool Additive)
+    {
+      if (Terms.size() == 1)
+        return Terms.front();
+      size_t Half = Terms.size() / 2;
+      Term L = build(Terms.take_front(Half), Additive);
+      Term R = build(Terms.drop_front(Half), Additive);
+      if (!Additive)
+        return {new BinaryOp(BinaryOp::Mul, L.E, R.E, true), false};
+      BinaryOp::Operator Op = L.Negative == R.Negative ? BinaryOp::Plus : BinaryOp::Minus;
+      return {new BinaryOp(Op, L.E, R.E, true), L.Negative};
+    }
+
+    Logic *build(llvm::ArrayRef<Logic *> Items, LogicalExpr::Operator Op)
+    {
+      if (Items.size() == 1)
+        return Items.front();
+      size_t Half = Items.size() / 2;
+      return new LogicalExpr(build(Items.take_front(Half), Op), build(Items.drop_front(Half), Op), Op);
+    }
+
+    template <typename Iterator>
+    void all(Iterator Begin, Iterator End)
+    {
+      for (Iterator I = Begin; I != End; ++I)
+        (*I)->accept(*this);
+    }
+
+  public:
+    RebalanceVisitor(unsigned &Chains, unsigned &Folded, unsigned &Longest)
+        : Chains(Chains), Folded(Folded), Longest(Longest) {}
+
+    virtual void visit(Program &Node) override
+    {
+      all(Node.begin(), Node.end());
+    };
+
+    virtual void visit(DeclarationInt &Node) override
+    {
+      llvm::SmallVector<Expr *> Values;
+      for (llvm::SmallVector<Expr *>::const_iterator I = Node.valBegin(), E = Node.valEnd(); I != E; ++I)
+        Values.push_back(rewrite(*I));
+      Node.setValues(Values);
+    };
+
+    virtual void visit(DeclarationBool &Node) override
+    {
+      llvm::SmallVector<Logic *> Values;
+      for (llvm::SmallVector<Logic *>::const_iterator I = Node.valBegin(), E = Node.valEnd(); I != E; ++I)
+        Values.push_back(rewrite(*I));
+      Node.setValues(Values);
+    };
+
+    virtual void visit(Assignment &Node) override
+    {
+      if (Node.getRightExpr())
+        Node.setRightExpr(rewrite(Node.getRightExpr()));
+      else
+        Node.setRightLogic(rewrite(Node.getRightLogic()));
+    };
+
+    virtual void visit(Final &Node) override
+    {
+      Result = &Node;
+    };
+
+    virtual void visit(BinaryOp &Node) override
+    {
+      BinaryOp::Operator Op = Node.getOperator();
+      bool Additive = Op == BinaryOp::Plus || Op == BinaryOp::Minus;
+      if (!Additive && Op != BinaryOp::Mul)
+      {
+        Node.setLeft(rewrite(Node.getLeft()));
+        Node.setRight(rewrite(Node.getRight()));
+        Result = &Node;
+        return;
+      }
+
+      // the operands left to right, literals folded into Constant
+      llvm::SmallVector<Term> Work, Terms;
+      llvm::SmallVector<Expr *> Operands;
+      int Identity = Additive ? 0 : 1;
+      int Constant = Identity;
+      unsigned Literals = 0;
+      Work.push_back({&Node, false});
+      while (!Work.empty())
+      {
+        Term T = Work.pop_back_val();
+        Shape O(T.E);
+        if (O.Kind == Shape::Binary && (Additive ? O.Op == BinaryOp::Plus || O.Op == BinaryOp::Minus : O.Op == BinaryOp::Mul))
+        {
+          Work.push_back({O.Right, T.Negative != (O.Op == BinaryOp::Minus)});
+          Work.push_back({O.Left, T.Negative});
+        }
+        else if (O.Kind == Shape::Literal)
+        {
+          ++Literals;
+          Constant = Additive ? wrapAdd(Constant, T.Negative ? ConstantFolder::neg(O.Value) : O.Value)
+                              : wrapMul(Constant, O.Value);
+          Operands.push_back(T.E);
+        }
+        else
+        {
+          Terms.push_back({rewrite(T.E), T.Negative});
+          Operands.push_back(Terms.back().E);
+        }
+      }
+
+      if (Operands.size() < 3 && Literals < 2)
+      {
+        // nothing to regroup
+        Node.setLeft(Operands[0]);
+        Node.setRight(Operands[1]);
+        Result = &Node;
+        return;
+      }
+      rebuilt(Operands.size());
+      if (Literals > 1)
+        Folded += Literals - 1;
+      if (Literals && (Terms.empty() || Constant != Identity))
+      {
+        Term C = {makeNumber(Constant), false};
+        if (Additive && Constant < 0 && Constant != INT_MIN)
+          C = {makeNumber(-Constant), true};
+        // a literal in front keeps the sum positive: 5 - a - b
+        if (!Terms.empty() && Terms.front().Negative && !C.Negative)
+          Terms.insert(Terms.begin(), C);
+        else
+          Terms.push_back(C);
+      }
+      Term Root = build(Terms, Additive);
+      Result = Root.Negative ? new NegExpr(Root.E) : Root.E;
+    };
+
+    virtual void visit(UnaryOp &Node) override
+    {
+      Result = &Node;
+    };
+
+    virtual void visit(SignedNumber &Node) override
+    {
+      Result = &Node;
+    };
+
+    virtual void visit(NegExpr &Node) override
+    {
+      Node.setExpr(rewrite(Node.getExpr()));
+      Result = &Node;
+    };
+
+    virtual void visit(Comparison &Node) override
+    {
+      LogicResult = &Node;
+      if (!Node.getRight())
+        return;
+      Node.setLeft(rewrite(Node.getLeft()));
+      Node.setRight(rewrite(Node.getRight()));
+    };
+
+    virtual void visit(LogicalExpr &Node) override
+    {
+      LogicalExpr::Operator Op = Node.getOperator();
+      llvm::SmallVector<Logic *> Work, Items;
+      Work.push_back(&Node);
+      while (!Work.empty())
+      {
+        Logic *L = Work.pop_back_val();
+        Shape O(L);
+        if (O.Kind != Shape::Logical || O.LogicOp != Op)
+        {
+          Items.push_back(rewrite(L));
+          continue;
+        }
+        if (O.RightCond)
+          Work.push_back(O.RightCond);
+        Work.push_back(O.LeftCond);
+      }
+
+      if (Items.size() < 3)
+      {
+        Node.setLeft(Items[0]);
+        Node.setRight(Items.size() > 1 ? Items[1] : nullptr);
+        LogicResult = &Node;
+        return;
+      }
+      rebuilt(Items.size());
+      LogicResult = build(Items, Op);
+    };
+
+    virtual void visit(IfStmt &Node) override
+    {
+      Node.setCond(rewrite(Node.getCond()));
+      all(Node.begin(), Node.end());
+      all(Node.beginElif(), Node.endElif());
+      all(Node.beginElse(), Node.endElse());
+    };
+
+    virtual void visit(elifStmt &Node) override
+    {
+      Node.setCond(rewrite(Node.getCond()));
+      all(Node.begin(), Node.end());
+    };
+
+    virtual void visit(WhileStmt &Node) override
+    {
+      Node.setCond(rewrite(Node.getCond()));
+      all(Node.begin(), Node.end());
+    };
+
+    virtual void visit(ForStmt &Node) override
+    {
+      Node.getFirst()->accept(*this);
+      Node.setSecond(rewrite(Node.getSecond()));
+      if (Node.getThirdAssign())
+        Node.getThirdAssign()->accept(*this);
+      all(Node.begin(), Node.end());
+    };
+
+    virtual void visit(PrintStmt &Node) override {};
+  };
+}
+
+void Reassociate::optimize(Program *Tree)
+{
+  if (!Tree)
+    return;
+  Chains = Folded = Longest = 0;
+  ra::RebalanceVisitor Rebalancer(Chains, Folded, Longest);
+  Tree->accept(Rebalancer);
+}
+
+void Reassociate::report(llvm::raw_ostream &OS)
+{
+  if (!Chains)
+    return;
+  OS << llvm::format("  chains rebuilt   %8u\n", Chains);
+  OS << llvm::format("  literals folded  %8u\n", Folded);
+  OS << llvm::format("  longest chain    %8u\n", Longest);
+}
@@ -0,0 +1,34 @@
+#ifndef REASSOCIATE_H
+#define REASSOCIATE_H
+
+#include "AST.h"
+#include "ASTPass.h"
+
+// Reassociation of long chains into balanced trees.
+// The parser builds a + b - c + d as ((a + b) - c) + d, so a sum of n
+// terms is a chain of n - 1 dependent instructions and n - 1 nested
+// nodes for every visitor after it. A chain of + and -, of *, of and or
+// of or is flattened, its literals are folded into one and it is rebuilt
+// as a balanced tree of depth log2 n with the operands in their original
+// order, so ++ and -- still happen in the order they are written.
+// Regrouping a sum may overflow where the original did not, so the
+// rebuilt + - and * wrap around, which gives the same value whenever the
+// original did not overflow.
+class Reassociate : public ASTPass
+{
+  unsigned Chains = 0;              // chains rebuilt
+  unsigned Folded = 0;              // literals folded into another one
+  unsigned Longest = 0;             // operands of the longest chain rebuilt
+
+public:
+  void optimize(Program *Tree);
+
+  virtual void visit(Program &Node) override
+  {
+    optimize(&Node);
+  };
+
+  virtual void report(llvm::raw_ostream &OS) override;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef STMTREWRITER_H
+#define STMTREWRITER_H
+
+#include "AST.h"
+#include <utility>
+
+// Base of the visitors that rebuild every statement list of a program.
+// A visited statement appends what replaces it to Out. By default it is kept
+// and the lists in it are rebuilt first, so the innermost lists come first.
+class StmtRewriter : public ASTVisitor
+{
+protected:
+  llvm::SmallVector<AST *> Out;     // rewritten statements of the list being visited
+
+  template <typename Iterator>
+  llvm::SmallVector<AST *> rewrite(Iterator Begin, Iterator End)
+  {
+    llvm::SmallVector<AST *> Outer;
+    std::swap(Outer, Out);
+    for (Iterator I = Begin; I != End; ++I)
+      (*I)->accept(*this);
+    std::swap(Outer, Out);
+    return Outer;
+  }
+
+public:
+  virtual void visit(Program &Node) override
+  {
+    Node.setdata(rewrite(Node.begin(), Node.end()));
+  };
+
+  virtual void visit(IfStmt &Node) override
+  {
+    Node.setBody(rewrite(Node.begin(), Node.end()));
+    for (llvm::SmallVector<elifStmt *>::const_iterator I = Node.beginElif(), E = Node.endElif(); I != E; ++I)
+      (*I)->setBody(rewrite((*I)->begin(), (*I)->end()));
+    Node.setElse(rewrite(Node.beginElse(), Node.endElse()));
+    Out.push_back(&Node);
+  };
+
+  virtual void visit(WhileStmt &Node) override
+  {
+    Node.setBody(rewrite(Node.begin(), Node.end()));
+    Out.push_back(&Node);
+  };
+
+  virtual void visit(ForStmt &Node) override
+  {
+    Node.setBody(rewrite(Node.begin(), Node.end()));
+    Out.push_back(&Node);
+  };
+
+  virtual void visit(elifStmt &Node) override {};
+
+  virtual void visit(Final &Node) override { Out.push_back(&Node); };
+  virtual void visit(BinaryOp &Node) override { Out.push_back(&Node); };
+  virtual void visit(UnaryOp &Node) override { Out.push_back(&Node); };
+  virtual void visit(SignedNumber &Node) override { Out.push_back(&Node); };
+  virtual void visit(NegExpr &Node) override { Out.push_back(&Node); };
+  virtual void visit(Assignment &Node) override { Out.push_back(&Node); };
+  virtual void visit(DeclarationInt &Node) override { Out.push_back(&Node); };
+  virtual void visit(DeclarationBool &Node) override { Out.push_back(&Node); };
+  virtual void visit(Comparison &Node) override { Out.push_back(&Node); };
+  virtual void visit(LogicalExpr &Node) override { Out.push_back(&Node); };
+  virtual void visit(PrintStmt &Node) override { Out.push_back(&Node); };
+};
+
+#endif
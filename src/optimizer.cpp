@@ -1,136 +1,236 @@
 #include "optimizer.h"
-#include "utils.h"
+#include "ConstantFolder.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringSet.h"
+#include <algorithm>
 #include <iostream>
+#include <set>
 
 // Constructor: Initialize optimizer with input buffer
-// - Splits the input code into lines and prepares for optimization
-// - Stores each line until semicolon in Lines vector
-// - Initializes tracking vectors for dead code elimination and optimized lines
 Optimizer::Optimizer(const llvm::StringRef &Buffer) {
-    BufferPtr = Buffer.begin();
-    const char *end = BufferPtr + 1;
-    while (*end) {
-        end++;
-    }
-    llvm::StringRef Context(BufferPtr, end - BufferPtr);
-    code = (std::string)Context;
-
-    const char *pointer = BufferPtr;
-    const char *line_start = BufferPtr;
-    while (*pointer) {
-        while (!utils::isSemiColon(*pointer)) {
-            ++pointer;
+    load(Buffer);
+}
+
+// Load a whole program
+// - Lexes the input code once, every later step works on the tokens
+// - Initializes tracking vectors for dead code elimination and optimized lines
+// - Builds the reaching-definition index used by evaluateLine
+void Optimizer::load(llvm::StringRef Buffer) {
+    Tokens.clear();
+    Lines.clear();
+    LineTokens.clear();
+    Definitions.clear();
+    boolVariables.clear();
+    UndefinedReads.clear();
+    Tail = lexLines(Buffer, Lines, LineTokens);
+    size_t n = Lines.size();
+    new_lines.assign(n, "");
+    Refs.assign(n, 0);
+    Types.assign(n, "");
+    Declarers.clear();
+    Changed.clear();
+    Deps.assign(n, {});
+    Users.assign(n, {});
+    values.assign(n, 0);
+    knownLines.assign(n, false);
+    evaluatedLines.assign(n, false);
+
+    //index every variable a line defines by the line that defines it
+    //lines are visited in order, so every list of line numbers stays sorted
+    llvm::SmallVector<llvm::StringRef, 4> names;
+    for (int i = 0; i < (int)n; i++) {
+        definedVariables(&Tokens[LineTokens[i]], names);
+        for (llvm::StringRef Name : names) {
+            std::vector<int> &DefLines = Definitions[Name];
+            if (DefLines.empty() || DefLines.back() != i)
+                DefLines.push_back(i);
+        }
+    }
+}
+
+// Split a text into statements
+// - Appends the tokens to Tokens, the text of each statement until its semicolon
+//   to texts and the index of its first token to firsts
+// Returns: The text after the last semicolon
+llvm::StringRef Optimizer::lexLines(llvm::StringRef Text, std::vector<llvm::StringRef> &texts,
+                                    std::vector<unsigned> &firsts) {
+    Lexer Lex(Text);
+    Token Tok;
+    const char *line_start = Text.begin();
+    unsigned first = Tokens.size();
+    Lex.next(Tok);
+    while (!Tok.is(Token::eoi)) {
+        Tokens.push_back(Tok);
+        if (Tok.is(Token::semicolon)) {
+            texts.push_back(llvm::StringRef(line_start, Tok.getText().begin() - line_start));
+            firsts.push_back(first);
+            line_start = Tok.getText().end();
+            first = Tokens.size();
         }
-        llvm::StringRef Context(line_start, pointer - line_start);
-        Lines.push_back(Context);
-        deadLines.push_back(true);
-        new_lines.push_back("");
-        line_start = ++pointer;
+        Lex.next(Tok);
     }
+    //the tokens after the last semicolon are not part of any line
+    Tokens.resize(first);
+    return llvm::StringRef(line_start, Text.end() - line_start);
 }
 
-// Parser helper functions
-// top(): Peek at current character without advancing position
-// Useful for lookahead during parsing
-char Optimizer::top(const char *&expr) {
-    return *expr;
+// Replace the entries [first, last) of a per-line vector by lines
+template <typename T>
+static void splice(std::vector<T> &vector, int first, int last, const std::vector<T> &lines) {
+    int common = std::min<int>(last - first, lines.size());
+    std::copy(lines.begin(), lines.begin() + common, vector.begin() + first);
+    if (common < last - first)
+        vector.erase(vector.begin() + first + common, vector.begin() + last);
+    else
+        vector.insert(vector.begin() + last, lines.begin() + common, lines.end());
 }
 
-// get(): Read and advance to next character
-// Advances the pointer position after reading
-char Optimizer::get(const char *&expr) {
-    return *expr++;
+// =, +=, -=, *= and /=
+static bool isAssignment(const Token &tok) {
+    return tok.isOneOf(Token::assign, Token::plus_assign, Token::minus_assign,
+                       Token::star_assign, Token::slash_assign);
+}
+
+// Variables defined by a statement
+// - Every name on the left side of the assignment
+// - A declaration without '=' defines its variables with the default value 0
+// - x++ and x-- define x as well, on their own or inside an expression
+// - Remembers the variables declared as bool
+// Parameters:
+//   tok: The first token of the statement
+//   names: Receives the defined variables
+void Optimizer::definedVariables(const Token *tok, llvm::SmallVectorImpl<llvm::StringRef> &names) {
+    names.clear();
+    bool is_bool = tok->is(Token::KW_bool);
+    //in front of the assignment, or anywhere in a declaration without one
+    bool assigned = tok->isOneOf(Token::KW_int, Token::KW_bool);
+    for (const Token *op = tok; !op->is(Token::semicolon); ++op) {
+        if (isAssignment(*op)) {
+            assigned = true;
+            break;
+        }
+    }
+    for (; !tok->is(Token::semicolon); ++tok) {
+        if (isAssignment(*tok)) {
+            assigned = false;
+            continue;
+        }
+        if (!tok->is(Token::ident))
+            continue;
+        bool stepped = tok[1].isOneOf(Token::plus_plus, Token::minus_minus);
+        if (assigned || stepped) {
+            names.push_back(tok->getText());
+            if (assigned && is_bool)
+                boolVariables.insert(tok->getText());
+        }
+    }
 }
 
 // Parse numeric values from the expression
-// - Handles multi-digit numbers
-// - Skips trailing whitespace
+// - Refuses literals that do not fit in i32
 // Returns: The parsed integer value
-int Optimizer::number(const char *&expr) {
-    int result = get(expr) - '0';
-    //traverse the number and add the digits to the result
-    while (top(expr) >= '0' && top(expr) <= '9') {
-        result = 10 * result + get(expr) - '0';
-    }
-    while (top(expr) == ' ')
-        get(expr);
+int Optimizer::number(const Token *&tok) {
+    int result = 0;
+    if (!ConstantFolder::number(tok->getText(), result))
+        foldable = false;
+    ++tok;
     return result;
 }
 
 // Handle variable references and constant propagation
-// - Processes variable names (letters and digits)
 // - Handles boolean literals (true/false)
 // - Performs constant propagation for variables
+// - x++ and x-- inside an expression change x, so the line is not folded
 // Parameters:
-//   expr: Current position in expression
+//   tok: Current token of the expression
 //   i: Current line number being processed
 // Returns: The evaluated value of the variable
-int Optimizer::variable(const char *&expr, int i) {
-    const char *temp = expr;
-    while (utils::isLetter(top(expr)) || utils::isDigit(top(expr))) {
-        get(expr);
-    }
-    llvm::StringRef name(temp, expr - temp);
-    while (top(expr) == ' ')
-        get(expr);
-    //check if it is a boolean literal
-    if (name == "true")
-        return 1;
-    else if (name == "false")
-        return 0;
-    //call the evaluateConstant function in recursive way
-    return evaluateConstant(i, name);
+int Optimizer::variable(const Token *&tok, int i) {
+    if (tok->isOneOf(Token::KW_true, Token::KW_false))
+        return (tok++)->is(Token::KW_true);
+    llvm::StringRef name = tok->getText();
+    ++tok;
+    if (tok->isOneOf(Token::plus_plus, Token::minus_minus)) {
+        ++tok;
+        foldable = false;
+    }
+    int value = 0;
+    if (!lookup(name, i, value))
+        foldable = false;
+    return value;
 }
 
 // Parse factors in the expression grammar
 // Handles:
 // - Numbers
 // - Parenthesized expressions
-// - Unary negation
+// - Unary negation (wraps around like CreateNeg)
 // - Variables
 // Returns: The evaluated value of the factor
-int Optimizer::factor(const char *&expr, int i) {
-    while (top(expr) == ' ')
-        get(expr);
-    if (top(expr) >= '0' && top(expr) <= '9')
-        return number(expr);
-    else if (top(expr) == '(') {
-        get(expr);
-        while (top(expr) == ' ')
-            get(expr);
-        int result = expression(expr, i);
-        while (top(expr) == ' ')
-            get(expr);
-        get(expr);
-        while (top(expr) == ' ')
-            get(expr);
-        return result;
+int Optimizer::factor(const Token *&tok, int i) {
+    if (tok->is(Token::number))
+        return number(tok);
+    else if (tok->isOneOf(Token::l_paren, Token::minus_paren)) {
+        bool negate = (tok++)->is(Token::minus_paren);
+        int result = condition(tok, i);
+        if (!tok->is(Token::r_paren)) {
+            foldable = false;
+            return 0;
+        }
+        ++tok;
+        return negate ? ConstantFolder::neg(result) : result;
+    }
+    else if (tok->is(Token::minus)) {
+        ++tok;
+        return ConstantFolder::neg(factor(tok, i));
     }
-    else if (top(expr) == '-') {
-        get(expr);
-        return -factor(expr, i);
+    else if (tok->is(Token::plus)) {
+        ++tok;
+        return factor(tok, i);
     }
-    else if (utils::isLetter(top(expr))) {
-        return variable(expr, i);
+    else if (tok->isOneOf(Token::ident, Token::KW_true, Token::KW_false)) {
+        return variable(tok, i);
     }
+    foldable = false;
     return 0;
 }
 
-// Parse and evaluate multiplication/division terms
-// - Processes sequences of * and / operations
+// Fold a binary operator with the semantics of the generated code
+// Marks the line as not foldable if the result would be undefined
+int Optimizer::binary(BinaryOp::Operator op, int left, int right) {
+    int result = 0;
+    if (!ConstantFolder::binary(op, left, right, result))
+        foldable = false;
+    return result;
+}
+
+// Parse and evaluate exponentiation
+// - ^ binds tighter than * and is right associative, as in the parser
+// Returns: The computed value of the power
+int Optimizer::power(const Token *&tok, int i) {
+    int result = factor(tok, i);
+    if (tok->is(Token::exp)) {
+        ++tok;
+        result = binary(BinaryOp::Exp, result, power(tok, i));
+    }
+    return result;
+}
+
+// Parse and evaluate multiplication/division/remainder terms
+// - Processes sequences of *, / and % operations
 // - Maintains operator precedence
 // Returns: The computed value of the term
-int Optimizer::term(const char *&expr, int i) {
-    while (top(expr) == ' ')
-        get(expr);
-    int result = factor(expr, i);
-    while (top(expr) == ' ')
-        get(expr);
-    while (top(expr) == '*' || top(expr) == '/') {
-        if (get(expr) == '*')
-            result *= factor(expr, i);
+int Optimizer::term(const Token *&tok, int i) {
+    int result = power(tok, i);
+    while (tok->isOneOf(Token::star, Token::slash, Token::mod)) {
+        Token::TokenKind op = (tok++)->getKind();
+        int right = power(tok, i);
+        if (op == Token::star)
+            result = binary(BinaryOp::Mul, result, right);
+        else if (op == Token::slash)
+            result = binary(BinaryOp::Div, result, right);
         else
-            result /= factor(expr, i);
+            result = binary(BinaryOp::Mod, result, right);
     }
     return result;
 }
@@ -139,17 +239,12 @@ int Optimizer::term(const char *&expr, int i) {
 // - Processes sequences of + and - operations
 // - Maintains operator precedence
 // Returns: The computed value of the arithmetic expression
-int Optimizer::condition(const char *&expr, int i) {
-    while (top(expr) == ' ')
-        get(expr);
-    int result = term(expr, i);
-    while (top(expr) == ' ')
-        get(expr);
-    while (top(expr) == '+' || top(expr) == '-') {
-        if (get(expr) == '+')
-            result += term(expr, i);
-        else
-            result -= term(expr, i);
+int Optimizer::condition(const Token *&tok, int i) {
+    int result = term(tok, i);
+    while (tok->isOneOf(Token::plus, Token::minus)) {
+        Token::TokenKind op = (tok++)->getKind();
+        int right = term(tok, i);
+        result = binary(op == Token::plus ? BinaryOp::Plus : BinaryOp::Minus, result, right);
     }
     return result;
 }
@@ -162,177 +257,718 @@ int Optimizer::condition(const char *&expr, int i) {
 // - >= (greater than or equal)
 // - == (equality)
 // - != (inequality)
+// A parenthesis at the start holds a whole logical expression, as in the parser
 // Returns: 1 if condition is true, 0 if false
-int Optimizer::expression(const char *&expr, int i) {
-    while (top(expr) == ' ')
-        get(expr);
-    int result = condition(expr, i);
-    while (top(expr) == ' ')
-        get(expr);
-    while (top(expr) == '<' || top(expr) == '>' || top(expr) == '=' || top(expr) == '!') {
-        if (top(expr) == '<') {
-            get(expr);
-            if (top(expr) == '=') {
-                get(expr);
-                result = result <= condition(expr, i);
-            }
-            else
-                result = result < condition(expr, i);
-        }
-        else if (top(expr) == '>') {
-            get(expr);
-            if (top(expr) == '=') {
-                get(expr);
-                result = result >= condition(expr, i);
-            }
-            else
-                result = result > condition(expr, i);
-        }
-        else if (top(expr) == '=') {
-            get(expr);
-            get(expr);
-            result = result == condition(expr, i);
-        }
-        else if (get(expr) == '!') {
-            get(expr);
-            result = result != condition(expr, i);
+int Optimizer::expression(const Token *&tok, int i) {
+    if (tok->is(Token::l_paren)) {
+        ++tok;
+        int result = logic(tok, i);
+        if (!tok->is(Token::r_paren)) {
+            foldable = false;
+            return 0;
         }
+        ++tok;
+        return result;
+    }
+    int result = condition(tok, i);
+    Comparison::Operator op;
+    switch (tok->getKind()) {
+    case Token::lte: op = Comparison::Less_equal; break;
+    case Token::gte: op = Comparison::Greater_equal; break;
+    case Token::eq: op = Comparison::Equal; break;
+    case Token::neq: op = Comparison::Not_equal; break;
+    case Token::lt: op = Comparison::Less; break;
+    case Token::gt: op = Comparison::Greater; break;
+    default: return result;
+    }
+    ++tok;
+    return ConstantFolder::comparison(op, result, condition(tok, i));
+}
+
+// Parse and evaluate logical expressions
+// - and/or have the same precedence and are left associative, as in the parser
+// Returns: 1 if the expression is true, 0 if false
+int Optimizer::logic(const Token *&tok, int i) {
+    int result = expression(tok, i);
+    while (tok->isOneOf(Token::KW_and, Token::KW_or)) {
+        LogicalExpr::Operator op = (tok++)->is(Token::KW_and) ? LogicalExpr::And : LogicalExpr::Or;
+        result = ConstantFolder::logical(op, result, expression(tok, i));
     }
     return result;
 }
 
-// Constant Propagation Algorithm
-// - Traces variable definitions backwards from current line
-// - Evaluates constant expressions
-// - Updates dead code tracking
-// - Generates optimized line replacements
+// Reaching definition lookup
+// - Binary searches the definition index for the last line before j
+//   that assigns the variable
 // Parameters:
 //   j: Current line number
-//   variab: Variable name to evaluate
-// Returns: The computed constant value for the variable
-//TODO: the main idea of this function is to find the variable in the previous lines and evaluate it
-int Optimizer::evaluateConstant(int j, llvm::StringRef var_str) {
-    int i = j;
-    bool flag = true;
-    while (i > 0 && flag) {
-        i--;
-        llvm::StringRef current_line = Lines[i];
-        const char *pointer = current_line.begin();
-
-        while (*pointer) {
-            //skip the whitespace
-            while (*pointer && utils::isWhitespace(*pointer)) {
-                ++pointer;
-            }
+//   variab: Variable name to look up
+// Returns: The defining line number, or -1 if the variable is never assigned before j
+int Optimizer::findDefinition(int j, llvm::StringRef var_str) {
+    llvm::StringMap<std::vector<int>>::const_iterator It = Definitions.find(var_str);
+    if (It == Definitions.end())
+        return -1;
+    const std::vector<int> &DefLines = It->second;
+    std::vector<int>::const_iterator Pos = std::lower_bound(DefLines.begin(), DefLines.end(), j);
+    if (Pos == DefLines.begin())
+        return -1;
+    return *(Pos - 1);
+}
 
-            //check if it is a variable
-            if (utils::isLetter(*pointer)) {
-                const char *end = pointer + 1;
-                // traverse the variable name
-                while (utils::isLetter(*end) || utils::isDigit(*end))
-                    ++end;
-                //get the variable name
-                llvm::StringRef Context(pointer, end - pointer);
-                //check if it is the variable we are looking for
-                if (Context == var_str) {
-                    flag = false;
-                    break;
-                }
-                pointer = end;
-            }else if (utils::isEqual(*pointer)) {
-                break;
+// Worklist evaluation of a definition and everything it depends on
+// - Keeps the pending lines on a heap-allocated stack instead of recursing
+//   once per dependency, so arbitrarily deep definition chains are safe
+// - A line is evaluated only after the reaching definitions of all the
+//   variables it reads, so expression() never has to recurse into other lines
+// - Records the definitions a line reads in Deps and Users
+// - Generates optimized line replacements, a print is kept as it is
+// Parameters:
+//   root: Line number of the definition to evaluate
+void Optimizer::evaluateLine(int root) {
+    std::vector<int> worklist;
+    llvm::SmallVector<int, 4> deps;
+    worklist.push_back(root);
+    while (!worklist.empty()) {
+        int i = worklist.back();
+        if (evaluatedLines[i]) {
+            worklist.pop_back();
+            continue;
+        }
+        const Token *tok = &Tokens[LineTokens[i]];
+        llvm::StringRef var;
+        bool print = isPrint(tok, var);
+        Statement statement;
+
+        //collect the definitions this line reads and push the ones not evaluated yet
+        bool ready = true;
+        deps.clear();
+        auto read = [&](llvm::StringRef name) {
+            int def = findDefinition(i, name);
+            if (def < 0) {
+                std::vector<int> &Readers = UndefinedReads[name];
+                if (Readers.empty() || Readers.back() != i)
+                    Readers.push_back(i);
+                return;
+            }
+            if (std::find(deps.begin(), deps.end(), def) == deps.end())
+                deps.push_back(def);
+            if (!evaluatedLines[def]) {
+                worklist.push_back(def);
+                ready = false;
             }
-            ++pointer;
+        };
+        if (print) {
+            if (!var.empty())
+                read(var);
+        } else {
+            statement = parseStatement(Lines[i], tok);
+            //x += 1 and x++ also read the previous value of x
+            if (statement.kind != Assignment::Assign)
+                read(statement.name);
+            for (tok = statement.rhs; !tok->is(Token::semicolon); ++tok)
+                if (tok->is(Token::ident))
+                    read(tok->getText());
         }
+        if (!ready)
+            continue;
+        worklist.pop_back();
+
+        Deps[i].assign(deps.begin(), deps.end());
+        for (int def : deps)
+            if (Users[def].empty() || Users[def].back() != i)
+                Users[def].push_back(i);
+        int value = 0;
+        if (print) {
+            new_lines[i] = Lines[i].str() + ";";
+            foldable = false;
+        } else {
+            new_lines[i] = foldStatement(Lines[i], statement, i, value);
+        }
+        values[i] = value;
+        knownLines[i] = foldable;
+        evaluatedLines[i] = true;
     }
-    //if the variable is not found, then it is a dead code
-    //TODO: this is for the dead code elimination and marking the line as dead/alive
-    deadLines[i] = false;
-    llvm::StringRef current_line = Lines[i];
-    const char *pointer = current_line.begin();
-    const char *start_exp = current_line.begin();
-    while (!utils::isEqual(*start_exp)) {
-        ++start_exp;
-    }
-    start_exp++;
-    llvm::StringRef new_line(pointer, start_exp - pointer);
-    start_exp++;
-    int value = expression(start_exp, i);
-    new_lines[i] = new_line.str() + " " + std::to_string(value) + ";";
-    return value;
+}
+
+// Reference a line from a root or a live line
+// - A line that comes alive is evaluated and references the definitions it reads
+void Optimizer::retain(int root) {
+    std::vector<int> worklist(1, root);
+    while (!worklist.empty()) {
+        int i = worklist.back();
+        worklist.pop_back();
+        if (Refs[i]++ > 0)
+            continue;
+        Changed.push_back(i);
+        evaluateLine(i);
+        worklist.insert(worklist.end(), Deps[i].begin(), Deps[i].end());
+    }
+}
+
+// Drop a reference taken by retain
+// - A line nobody references any more is dead and releases the definitions it reads
+void Optimizer::release(int root) {
+    std::vector<int> worklist(1, root);
+    while (!worklist.empty()) {
+        int i = worklist.back();
+        worklist.pop_back();
+        if (--Refs[i] > 0)
+            continue;
+        Changed.push_back(i);
+        worklist.insert(worklist.end(), Deps[i].begin(), Deps[i].end());
+    }
+}
+
+// Current value of a variable read by line i
+// - Streaming: the constant recorded by the lines already read
+// - Otherwise: the value of the reaching definition, which evaluateLine has already evaluated
+// Returns: false if the value is not a known constant
+bool Optimizer::lookup(llvm::StringRef name, int i, int &value) {
+    if (streaming) {
+        llvm::StringMap<int>::const_iterator It = constants.find(name);
+        if (It == constants.end())
+            return false;
+        value = It->second;
+        return true;
+    }
+    int def = findDefinition(i, name);
+    if (def < 0 || !knownLines[def])
+        return false;
+    value = values[def];
+    return true;
+}
+
+// Split a statement at its assignment operator
+// - Recognizes =, +=, -=, *=, /=, x++, x-- and declarations without initializer
+// Parameters:
+//   line: The statement without its semicolon
+//   tok: The first token of the statement
+// Returns: The parts of the statement (they point into line and its tokens)
+Optimizer::Statement Optimizer::parseStatement(llvm::StringRef line, const Token *tok) {
+    Statement statement;
+    statement.kind = Assignment::Assign;
+    const Token *op = tok;
+    while (!op->is(Token::semicolon) && !isAssignment(*op))
+        ++op;
+    statement.declaration = op->is(Token::semicolon) && tok->isOneOf(Token::KW_int, Token::KW_bool);
+    statement.step = op->is(Token::semicolon) && !statement.declaration;
+    statement.rhs = op;
+    if (statement.step) {
+        //x++ or x-- on its own
+        op = tok;
+        while (!op->isOneOf(Token::semicolon, Token::plus_plus, Token::minus_minus))
+            ++op;
+        statement.kind = op->is(Token::plus_plus) ? Assignment::Plus_assign : Assignment::Minus_assign;
+    } else if (!statement.declaration) {
+        statement.rhs = op + 1;
+        switch (op->getKind()) {
+        case Token::plus_assign: statement.kind = Assignment::Plus_assign; break;
+        case Token::minus_assign: statement.kind = Assignment::Minus_assign; break;
+        case Token::star_assign: statement.kind = Assignment::Star_assign; break;
+        case Token::slash_assign: statement.kind = Assignment::Slash_assign; break;
+        default: break;
+        }
+    }
+    statement.lhs = llvm::StringRef(line.begin(), op->getText().begin() - line.begin()).rtrim();
+    //the assigned variable is the last name in front of the operator
+    statement.list = false;
+    for (; tok != op; ++tok) {
+        if (tok->is(Token::ident))
+            statement.name = tok->getText();
+        else if (tok->is(Token::comma))
+            statement.list = true;
+    }
+    return statement;
+}
+
+// Fold a statement whose operands are known
+// - Evaluates the right side as a condition for bool variables and as arithmetic otherwise
+// - Clears foldable if any part of the statement can not be folded
+// Parameters:
+//   line: The statement without its semicolon
+//   statement: The statement split by parseStatement
+//   i: Line number of the statement (unused while streaming)
+//   value: Receives the value assigned to the variable
+// Returns: The folded statement, or the original one if it can not be folded
+std::string Optimizer::foldStatement(llvm::StringRef line, const Statement &statement, int i, int &value) {
+    if (statement.declaration) {
+        //the variables start at 0
+        foldable = true;
+        value = 0;
+        return line.str() + ";";
+    }
+    //a line that declares several variables is kept as it is
+    foldable = !statement.list && !statement.name.empty();
+    bool is_bool = boolVariables.count(statement.name);
+    int right = 1;
+    if (!statement.step) {
+        const Token *tok = statement.rhs;
+        right = is_bool ? logic(tok, i) : condition(tok, i);
+        if (!tok->is(Token::semicolon))
+            foldable = false;
+    }
+    value = right;
+    if (statement.kind != Assignment::Assign) {
+        int old = 0;
+        if (!lookup(statement.name, i, old) || !ConstantFolder::assign(statement.kind, old, right, value))
+            foldable = false;
+    }
+    if (!foldable)
+        return line.str() + ";";
+    std::string text = is_bool ? (value ? "true" : "false") : std::to_string(value);
+    return statement.lhs.str() + " = " + text + ";";
+}
+
+// Print statement detection
+// - Matches a line of the form print(var)
+// Parameters:
+//   tok: The first token of the line
+//   var: Receives the printed variable
+// Returns: true if the line is a print statement
+bool Optimizer::isPrint(const Token *tok, llvm::StringRef &var) {
+    if (!tok->is(Token::KW_print) || !tok[1].is(Token::l_paren))
+        return false;
+    if (tok[2].is(Token::ident))
+        var = tok[2].getText();
+    return true;
 }
 
 // Main optimization function
 // Performs multiple optimization passes:
-// 1. Constant propagation starting from output variable
-// 2. Dead code elimination for unused statements
-// 3. Variable declaration management:
-//    - Tracks initialized variables
-//    - Adds missing declarations
-//    - Maintains proper scoping
+// 1. Constant propagation starting from the roots: every print statement
+//    and the final value of every output variable
+// 2. Dead code elimination for the statements no root depends on
+// 3. Variable declaration management, see emit
+// Returns: The optimized code as a single string
+std::string Optimizer::optimize(llvm::ArrayRef<std::string> outputs) {
+    OutputNames.assign(outputs.begin(), outputs.end());
+    OutputRoots.clear();
+    for (const std::string &output : outputs) {
+        int def = findDefinition(Lines.size(), output);
+        OutputRoots.push_back(def);
+        if (def >= 0)
+            retain(def);
+    }
+    //a print is kept as it is and keeps the definition it prints alive
+    for (int i = 0; i < (int)Lines.size(); i++) {
+        llvm::StringRef var;
+        if (isPrint(&Tokens[LineTokens[i]], var))
+            retain(i);
+    }
+
+    //the first live line that declares or assigns a variable declares it in the output
+    llvm::SmallVector<llvm::StringRef, 4> names;
+    for (int i = 0; i < (int)Lines.size(); i++) {
+        if (Refs[i] == 0)
+            continue;
+        definedVariables(&Tokens[LineTokens[i]], names);
+        for (llvm::StringRef name : names) {
+            llvm::StringRef type;
+            if (!Declarers.count(name) && declares(i, name, type)) {
+                Declarers[name] = i;
+                Types[i] = type;
+            }
+        }
+    }
+    Changed.clear();
+    return emit();
+}
+
+// Variable declaration management
+// - A declaration declares its variables
+// - A plain assignment, or a line folded into one, declares its variable when it is the
+//   first live line to do so: the type is added in front of it
+// Parameters:
+//   i: Line number
+//   name: A variable the line defines
+//   type: Receives the type to add in front of the line
+// Returns: true if the line declares the variable in the output
+bool Optimizer::declares(int i, llvm::StringRef name, llvm::StringRef &type) {
+    const Token *tok = &Tokens[LineTokens[i]];
+    llvm::StringRef var;
+    type = "";
+    //TODO this is for Redundant Assignments Elimination to ignore the variables that are already initialized
+    if (isPrint(tok, var))
+        return false;
+    if (tok->isOneOf(Token::KW_int, Token::KW_bool))
+        return true;
+    Statement statement = parseStatement(Lines[i], tok);
+    bool assignment = (statement.kind == Assignment::Assign && !statement.declaration) || knownLines[i];
+    if (!assignment || statement.name != name)
+        return false;
+    type = boolVariables.count(name) ? "bool " : "int ";
+    return true;
+}
+
+// Find the line that declares a variable again after lines came alive, died or changed
+void Optimizer::declare(llvm::StringRef name) {
+    int &line = Declarers.try_emplace(name, -1).first->second;
+    if (line >= 0)
+        Types[line] = "";
+    line = -1;
+    llvm::StringMap<std::vector<int>>::const_iterator It = Definitions.find(name);
+    if (It == Definitions.end())
+        return;
+    for (int i : It->second) {
+        llvm::StringRef type;
+        if (Refs[i] > 0 && declares(i, name, type)) {
+            Types[i] = type;
+            line = i;
+            return;
+        }
+    }
+}
+
+// Write the live lines, with the type of the variable in front of the ones that declare it
 // Returns: The optimized code as a single string
-std::string Optimizer::optimize() {
-    int i = Lines.size();
-    evaluateConstant(i, "output");
+std::string Optimizer::emit() {
     code = "";
     int len = Lines.size();
+    for (int i = 0; i < len; i++) {
+        if (Refs[i] == 0)
+            continue;
+        llvm::StringRef text = new_lines[i];
+        //remove the first character if it is a newline that is empty
+        if (text[0] == '\n')
+            text = text.drop_front();
+        code.append(Types[i].begin(), Types[i].end());
+        code.append(text.begin(), text.end());
+        //append a newline if it is not the last line
+        if (i != len - 1) {
+            code.append("\n");
+        }
+    }
+    return code;
+}
 
-    std::vector<std::string> initialized_variables;
+// Incremental optimization of an edited program
+// - The statements at the start and at the end that are unchanged keep their results,
+//   only the statements in between are lexed again
+// - Re-evaluates the lines whose reaching definition changed with the edit and, as long
+//   as their value changes, the lines that read them; everything else keeps its result
+// - The dead lines follow from the reference counts, no pass over the program is needed
+// - Adding or removing a bool declaration changes how other lines are evaluated,
+//   so such an edit optimizes the whole program again
+// Parameters:
+//   Buffer: The edited program, it is copied as far as it is needed
+// Returns: The optimized code as a single string
+std::string Optimizer::update(llvm::StringRef Buffer) {
+    int n = Lines.size();
 
-    i = 0;
-    while (i < len) {
-        if (!deadLines[i]) {
-            //remove the first character if it is a newline that is empty
-            if ((int)new_lines[i][0] == 10) {
-                new_lines[i] = new_lines[i].substr(1);
-            }
-            std::string temp_str = new_lines[i];
-            std::vector<std::string> temp = utils::split(temp_str, " ");
+    //the unchanged statements at the start: lines [0, first)
+    int first = 0;
+    size_t prefix = 0;
+    while (first < n) {
+        llvm::StringRef line = Lines[first];
+        if (!Buffer.substr(prefix).startswith(line) || Buffer.size() <= prefix + line.size() ||
+            Buffer[prefix + line.size()] != ';')
+            break;
+        prefix += line.size() + 1;
+        first++;
+    }
+    //the unchanged statements at the end: lines [last, n), a semicolon or the prefix in front
+    //of a line makes sure the changed text does not run into it
+    int last = n;
+    size_t suffix = Buffer.size();
+    if (Buffer.endswith(Tail) && Buffer.size() - Tail.size() >= prefix) {
+        suffix -= Tail.size();
+        while (last > first) {
+            llvm::StringRef line = Lines[last - 1];
+            if (suffix < prefix + line.size() + 1)
+                break;
+            size_t start = suffix - line.size() - 1;
+            if (Buffer[suffix - 1] != ';' || Buffer.substr(start, line.size()) != line ||
+                (start != prefix && Buffer[start - 1] != ';'))
+                break;
+            suffix = start;
+            last--;
+        }
+    }
+    if (last == n)
+        suffix = Buffer.size();
+    if (first == n && last == n && Buffer.substr(prefix) == Tail)
+        return code;
 
-            int j = 0;
-            while (temp[j] != "int" && temp[j] != "=" && temp[j] != "bool") {
-                j++;
-            }
+    std::vector<llvm::StringRef> texts;
+    std::vector<unsigned> firsts;
+    llvm::StringRef Middle = Saver.save(Buffer.substr(prefix, suffix - prefix));
+    llvm::StringRef Rest = lexLines(Middle, texts, firsts);
+    int added = texts.size();
+
+    llvm::StringRef var;
+    bool bools = false;
+    for (int i = first; i < last; i++)
+        bools |= Tokens[LineTokens[i]].is(Token::KW_bool);
+    for (unsigned tok : firsts)
+        bools |= Tokens[tok].is(Token::KW_bool);
+    if (bools) {
+        std::vector<std::string> outputs = std::move(OutputNames);
+        load(Saver.save(Buffer));
+        return optimize(outputs);
+    }
+
+    //the lines after the edit whose reaching definition may change: the readers of a
+    //removed line and of the definition that reached the edit for a name it assigns
+    std::vector<int> dirty;
+    auto readers = [&](const std::vector<int> &lines) {
+        for (int u : lines)
+            if (u >= last && u < n)
+                dirty.push_back(u);
+    };
+    llvm::StringSet<> assigned;
+    llvm::SmallVector<llvm::StringRef, 4> names;
+    std::vector<int> pending;
+    for (int r = first; r < last; r++) {
+        readers(Users[r]);
+        definedVariables(&Tokens[LineTokens[r]], names);
+        for (llvm::StringRef name : names)
+            assigned.insert(name);
+        //a removed live line no longer references what it read
+        if (Refs[r] > 0)
+            for (int def : Deps[r])
+                if (def < first)
+                    pending.push_back(def);
+    }
+    for (unsigned tok : firsts) {
+        definedVariables(&Tokens[tok], names);
+        for (llvm::StringRef name : names)
+            assigned.insert(name);
+    }
+    for (const auto &name : assigned) {
+        int def = findDefinition(last, name.getKey());
+        if (def >= first)
+            continue;
+        if (def >= 0) {
+            readers(Users[def]);
+        } else {
+            llvm::StringMap<std::vector<int>>::const_iterator It = UndefinedReads.find(name.getKey());
+            if (It != UndefinedReads.end())
+                readers(It->second);
+        }
+    }
+    //forget what the dirty lines read, while their old results stay in place for comparison
+    for (int j : dirty) {
+        if (!evaluatedLines[j])
+            continue;
+        if (Refs[j] > 0)
+            for (int def : Deps[j])
+                if (def < first || def >= last)
+                    pending.push_back(def);
+        Deps[j].clear();
+        evaluatedLines[j] = false;
+    }
+
+    //replace lines [first, last) by the new ones and renumber the lines behind them
+    int shift = added - (last - first);
+    auto renumber = [&](std::vector<int> &lines) {
+        size_t k = 0;
+        for (int v : lines) {
+            if (v >= last)
+                lines[k++] = v + shift;
+            else if (v < first)
+                lines[k++] = v;
+        }
+        lines.resize(k);
+    };
+    splice(Lines, first, last, texts);
+    splice(LineTokens, first, last, firsts);
+    splice(new_lines, first, last, std::vector<std::string>(added));
+    splice(Refs, first, last, std::vector<int>(added, 0));
+    splice(Types, first, last, std::vector<llvm::StringRef>(added));
+    splice(Deps, first, last, std::vector<llvm::SmallVector<int, 2>>(added));
+    splice(Users, first, last, std::vector<std::vector<int>>(added));
+    splice(values, first, last, std::vector<int>(added, 0));
+    splice(knownLines, first, last, std::vector<bool>(added, false));
+    splice(evaluatedLines, first, last, std::vector<bool>(added, false));
+    if (shift != 0) {
+        //only a change in the number of lines moves the line numbers behind the edit
+        for (int i = 0; i < (int)Lines.size(); i++) {
+            renumber(Users[i]);
+            if (i >= first + added)
+                for (int &def : Deps[i])
+                    if (def >= last)
+                        def += shift;
+        }
+        for (auto &Entry : Definitions)
+            renumber(Entry.second);
+        for (auto &Entry : UndefinedReads)
+            renumber(Entry.second);
+        for (auto &Entry : Declarers)
+            if (Entry.second >= first)
+                Entry.second = Entry.second >= last ? Entry.second + shift : -1;
+    } else {
+        //the numbers stay, only the lines that were replaced are dropped
+        for (const auto &name : assigned) {
+            renumber(Definitions[name.getKey()]);
+            llvm::StringMap<int>::iterator It = Declarers.find(name.getKey());
+            if (It != Declarers.end() && It->second >= first && It->second < last)
+                It->second = -1;
+        }
+    }
+    for (int &j : dirty)
+        j += shift;
+    for (int &def : pending)
+        if (def >= last)
+            def += shift;
+    for (int &root : OutputRoots)
+        if (root >= first)
+            root = root >= last ? root + shift : -1;
+    if (last == n)
+        Tail = Rest;
+    n = Lines.size();
+    for (int k = 0; k < added; k++) {
+        definedVariables(&Tokens[firsts[k]], names);
+        for (llvm::StringRef name : names) {
+            std::vector<int> &DefLines = Definitions[name];
+            std::vector<int>::iterator Pos = std::lower_bound(DefLines.begin(), DefLines.end(), first + k);
+            if (Pos == DefLines.end() || *Pos != first + k)
+                DefLines.insert(Pos, first + k);
+        }
+    }
 
-            //TODO this is for Redundant Assignments Elimination to ignore the variables that are already initialized
-            if (temp[j] == "int" || temp[j] == "bool") {
-                j++;
-                while (temp[j] == " ") {
-                    j++;
-                }
-                //add the variable to the initialized_variables vector
-                initialized_variables.push_back(temp[j]);//bug fixed from j+1 to j
-            }else {
-                int flag = 0;
-                for (int k = 0; k < initialized_variables.size(); k++) {
-                    std::string temp_str = new_lines[i];
-                    std::vector<std::string> temp = utils::split(temp_str, " ");
-                    int j = 0;
-                    //search for old variables in the line
-                    while (temp[j] != "=") {
-                        if (initialized_variables[k] == temp[j]) flag = 1;
-                        j++;
-                    }
-                }
-                if (flag == 0) {
-                    //it is a new variable so add int to the line
-                    new_lines[i] = "int " + new_lines[i];
-                    std::string temp_str = new_lines[i];
-                    std::vector<std::string> temp = utils::split(temp_str, " ");
-                    j = 0;
-                    while (temp[j] == "int" || temp[j] == " ") {
-                        j++;
-                    }
-                    initialized_variables.push_back(temp[j]);
-                }
+    //evaluate the dirty lines in order, a line whose value changed makes its readers dirty
+    //the readers of a line come after it, so a line is never queued again once evaluated
+    std::set<int> queue(dirty.begin(), dirty.end());
+    while (!queue.empty()) {
+        int j = *queue.begin();
+        queue.erase(queue.begin());
+        if (evaluatedLines[j]) {
+            if (Refs[j] > 0)
+                pending.insert(pending.end(), Deps[j].begin(), Deps[j].end());
+            Deps[j].clear();
+            evaluatedLines[j] = false;
+        }
+        bool known = knownLines[j];
+        int value = values[j];
+        evaluateLine(j);
+        Changed.push_back(j);
+        if (Refs[j] > 0)
+            for (int def : Deps[j])
+                retain(def);
+        if (knownLines[j] == known && (!known || values[j] == value))
+            continue;
+        queue.insert(Users[j].begin(), Users[j].end());
+    }
+
+    //the roots: the final definitions of the outputs and the new print statements
+    for (size_t k = 0; k < OutputNames.size(); k++) {
+        int def = findDefinition(n, OutputNames[k]);
+        if (def == OutputRoots[k])
+            continue;
+        if (OutputRoots[k] >= 0)
+            pending.push_back(OutputRoots[k]);
+        if (def >= 0)
+            retain(def);
+        OutputRoots[k] = def;
+    }
+    for (int k = first; k < first + added; k++)
+        if (isPrint(&Tokens[LineTokens[k]], var))
+            retain(k);
+    //references are dropped last, so a line that stays alive is never released on the way
+    for (int def : pending)
+        release(def);
+
+    //place the declarations again for the variables of the lines that changed
+    for (int i : Changed) {
+        definedVariables(&Tokens[LineTokens[i]], names);
+        for (llvm::StringRef name : names)
+            assigned.insert(name);
+    }
+    Changed.clear();
+    for (const auto &name : assigned)
+        declare(name.getKey());
+    return emit();
+}
+
+// Streaming optimization
+// - Reads the program in fixed-size chunks and folds every statement as soon as its
+//   semicolon is read, using the constants recorded by the statements before it
+// - Only those constants and the unfinished statement are kept in memory
+// - Statements are written in their original order, dead ones included: finding them
+//   needs the whole program, so that is left to the dead code elimination on the AST
+// Parameters:
+//   in: The program
+//   out: Receives the optimized program
+void Optimizer::optimizeStream(std::istream &in, llvm::raw_ostream &out) {
+    const size_t chunk_size = 1 << 16;
+    streaming = true;
+    std::string pending;
+    std::vector<char> chunk(chunk_size);
+    llvm::SmallVector<llvm::StringRef, 4> names;
+    llvm::SmallVector<Token, 32> statement_tokens;
+    //offset in pending where the last chunk stopped lexing the unfinished statement
+    size_t resume = 0;
+    while (in) {
+        in.read(chunk.data(), chunk_size);
+        pending.append(chunk.data(), in.gcount());
+        //lexing goes on where it stopped, once the unfinished statement is complete
+        //it is lexed from its start a second time
+        Lexer Lex(pending);
+        Lex.setBufferPtr(pending.data() + resume);
+        bool resumed = resume != 0;
+        const char *line_start = pending.data();
+        Token Tok;
+        while (true) {
+            statement_tokens.clear();
+            const char *last = Lex.getBuffer(), *cut = last;
+            do {
+                cut = last;
+                last = Lex.getBuffer();
+                Lex.next(Tok);
+                statement_tokens.push_back(Tok);
+            } while (!Tok.isOneOf(Token::semicolon, Token::eoi));
+            if (Tok.is(Token::eoi)) {
+                //the last token may be cut by the chunk end, so it is lexed again
+                resume = cut - line_start;
+                break;
+            }
+            if (resumed) {
+                resumed = false;
+                Lex.setBufferPtr(line_start);
+                continue;
+            }
+            llvm::StringRef line(line_start, Tok.getText().begin() - line_start);
+            line_start = Tok.getText().end();
+            const Token *tok = statement_tokens.data();
+            //a brace or a loop header ends the straight-line code: the statements around
+            //it may run any number of times, so nothing known before it holds after it
+            const Token *brace = nullptr;
+            for (const Token &T : statement_tokens)
+                if (T.isOneOf(Token::l_brace, Token::r_brace))
+                    brace = &T;
+            if (brace) {
+                const char *brace_end = brace->getText().end();
+                out << llvm::StringRef(line.begin(), brace_end - line.begin());
+                constants.clear();
+                line = llvm::StringRef(brace_end, line.end() - brace_end);
+                tok = brace + 1;
             }
-            code.append(new_lines[i]);
-            //append a newline if it is not the last line
-            if (i != new_lines.size() - 1) {
-                code.append("\n");
+            if (tok->isOneOf(Token::KW_for, Token::KW_while, Token::KW_if)) {
+                out << line << ";";
+                constants.clear();
+                continue;
+            }
+            llvm::StringRef var;
+            definedVariables(tok, names);
+            if (names.empty() || isPrint(tok, var)) {
+                out << line << ";";
+                continue;
+            }
+            Statement statement = parseStatement(line, tok);
+            int value = 0;
+            out << foldStatement(line, statement, -1, value);
+            //record what the statement leaves in its variables
+            for (llvm::StringRef name : names)
+                constants.erase(name);
+            if (statement.declaration) {
+                for (llvm::StringRef name : names)
+                    constants[name] = 0;
+            } else if (foldable) {
+                constants[statement.name] = value;
             }
         }
-        i++;
+        pending.erase(0, line_start - pending.data());
     }
-    return code;
-} 
\ No newline at end of file
+    //the text after the last semicolon is not a statement
+    out << pending;
+}
@@ -1,41 +1,115 @@
 #ifndef OPTIMIZER_H
 #define OPTIMIZER_H
 
+#include <istream>
 #include <string>
 #include <vector>
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
-
-namespace utils {
-    LLVM_READNONE inline bool isWhitespace(char c);
-    LLVM_READNONE inline bool isDigit(char c);
-    LLVM_READNONE inline bool isLetter(char c);
-    LLVM_READNONE inline bool isSemiColon(char c);
-    LLVM_READNONE inline bool isEqual(char c);
-    std::vector<std::string> split(std::string &s, const std::string &delimiter);
-}
-
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/StringSaver.h"
+#include "llvm/Support/raw_ostream.h"
+#include "AST.h"
+#include "Lexer.h"
 
 class Optimizer {
 private:
+    // A statement split at its assignment operator, the parts point into the line
+    struct Statement {
+        llvm::StringRef lhs;        // text in front of the operator
+        llvm::StringRef name;       // the assigned variable
+        const Token *rhs;           // the right side, it ends at the semicolon
+        Assignment::AssignKind kind;
+        bool declaration;           // a declaration without initializer
+        bool step;                  // x++ or x--
+        bool list;                  // several variables in front of the operator
+    };
+
+    // The program is lexed once, every statement is a run of tokens ending with its semicolon
+    std::vector<Token> Tokens;
+    // Text of every statement without its semicolon, and the index of its first token
     std::vector<llvm::StringRef> Lines;
+    std::vector<unsigned> LineTokens;
+    // The text after the last semicolon, it is not a statement
+    llvm::StringRef Tail;
     std::vector<std::string> new_lines;
-    std::vector<bool> deadLines;
+    // Roots and live lines that read the line; a line nobody references is dead.
+    // A line only reads definitions in front of it, so the counts are exact
+    std::vector<int> Refs;
+    // Lines that came alive or died since the declarations were last placed
+    std::vector<int> Changed;
+    // The type written in front of a line that is the first to assign its variable
+    std::vector<llvm::StringRef> Types;
+    // Variable name -> the first live line that declares it in the output, -1 if none
+    llvm::StringMap<int> Declarers;
+    // Reaching definitions an evaluated line read
+    std::vector<llvm::SmallVector<int, 2>> Deps;
+    // Lines that read the definition of a line, may hold lines that no longer do
+    std::vector<std::vector<int>> Users;
+    // Lines that read a variable with no definition in front of them
+    llvm::StringMap<std::vector<int>> UndefinedReads;
+    // The output variables and the line that defines their final value
+    std::vector<std::string> OutputNames;
+    std::vector<int> OutputRoots;
+    // Text of the edits given to update, the lines point into it
+    llvm::BumpPtrAllocator Allocator;
+    llvm::StringSaver Saver{Allocator};
+    // Per-line cache of evaluated definitions, so each line is evaluated at most once
+    std::vector<int> values;
+    // The line folded to a constant, otherwise its original text is kept and values is unused
+    std::vector<bool> knownLines;
+    std::vector<bool> evaluatedLines;
+    // Reaching-definition index: variable name -> sorted numbers of the lines that assign it
+    llvm::StringMap<std::vector<int>> Definitions;
+    // Variables declared as bool, their lines are evaluated as conditions
+    llvm::StringSet<> boolVariables;
+    // Cleared while a line is evaluated if any part of it can not be folded
+    bool foldable;
+    // Streaming mode keeps no lines, only the variables that hold a known constant
+    bool streaming = false;
+    llvm::StringMap<int> constants;
     std::string code;
-    const char *BufferPtr;
 
-    char top(const char *&expr);
-    char get(const char *&expr);
-    int number(const char *&expr);
-    int variable(const char *&expr, int i);
-    int factor(const char *&expr, int i);
-    int term(const char *&expr, int i);
-    int condition(const char *&expr, int i);
-    int expression(const char *&expr, int i);
-    int evaluateConstant(int j, llvm::StringRef variab);
+    int number(const Token *&tok);
+    int variable(const Token *&tok, int i);
+    int factor(const Token *&tok, int i);
+    int binary(BinaryOp::Operator op, int left, int right);
+    int power(const Token *&tok, int i);
+    int term(const Token *&tok, int i);
+    int condition(const Token *&tok, int i);
+    int expression(const Token *&tok, int i);
+    int logic(const Token *&tok, int i);
+    int findDefinition(int j, llvm::StringRef variab);
+    void load(llvm::StringRef Buffer);
+    llvm::StringRef lexLines(llvm::StringRef Text, std::vector<llvm::StringRef> &texts, std::vector<unsigned> &firsts);
+    void evaluateLine(int root);
+    void retain(int root);
+    void release(int root);
+    bool declares(int i, llvm::StringRef name, llvm::StringRef &type);
+    void declare(llvm::StringRef name);
+    std::string emit();
+    void definedVariables(const Token *tok, llvm::SmallVectorImpl<llvm::StringRef> &names);
+    bool lookup(llvm::StringRef name, int i, int &value);
+    Statement parseStatement(llvm::StringRef line, const Token *tok);
+    std::string foldStatement(llvm::StringRef line, const Statement &statement, int i, int &value);
+    bool isPrint(const Token *tok, llvm::StringRef &var);
 
 public:
+    // The buffer must outlive the optimizer, the lines point into it
     Optimizer(const llvm::StringRef &Buffer);
-    std::string optimize();
+    // Streaming mode, the program is given to optimizeStream
+    Optimizer() {}
+    std::string optimize(llvm::ArrayRef<std::string> outputs);
+    // Incremental mode, after optimize: Buffer is the edited program, only the changed
+    // statements and the definitions that depend on them are evaluated again
+    std::string update(llvm::StringRef Buffer);
+    // Folds the program chunk by chunk. Its memory is bounded by the longest
+    // statement and by the number of variables holding a known constant since
+    // the last brace, whether or not they are read again.
+    void optimizeStream(std::istream &in, llvm::raw_ostream &out);
 };
 
 #endif // OPTIMIZER_H 
\ No newline at end of file
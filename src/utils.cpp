@@ -1,42 +0,0 @@
-#include "utils.h"
-
-namespace utils {
-    bool isWhitespace(char c) {
-        return c == ' ' || c == '\t' || c == '\f' ||
-               c == '\v' || c == '\r' || c == '\n';
-    }
-
-    bool isDigit(char c) {
-        return c >= '0' && c <= '9';
-    }
-
-    bool isLetter(char c) {
-        return (c >= 'a' && c <= 'z') ||
-               (c >= 'A' && c <= 'Z');
-    }
-
-    bool isSemiColon(char c) {
-        return c == ';';
-    }
-
-    bool isEqual(char c) {
-        return c == '=';
-    }
-
-    
-    // Splits a string using a delimiter
-    // delimiter is the string to split on
-    // example: split("hello world", " ") -> ["hello", "world"]
-    std::vector<std::string> split(std::string &s, const std::string &delimiter) {
-        std::vector<std::string> tokens;
-        size_t pos = 0;
-        std::string token;
-        while ((pos = s.find(delimiter)) != std::string::npos) {
-            token = s.substr(0, pos);
-            tokens.push_back(token);
-            s.erase(0, pos + delimiter.length());
-        }
-        tokens.push_back(s);
-        return tokens;
-    }
-} 
\ No newline at end of file